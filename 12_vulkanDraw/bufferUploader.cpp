@@ -0,0 +1,436 @@
+#include "bufferUploader.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static VkCommandPool
+createPool(VkDevice device, uint32_t family,
+           const VkAllocationCallbacks *pAllocator) {
+    // one time command buffers, freed individually
+    VkCommandPoolCreateInfo poolInfo {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                         VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = family;
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+
+    if(vkCreateCommandPool(device, &poolInfo, pAllocator, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    return pool;
+}
+
+/*------------------------------------------------------------------*/
+
+static VkCommandBuffer
+beginOneTimeCommands(VkDevice device, VkCommandPool pool) {
+    VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+    VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+    if(vkAllocateCommandBuffers(device, &allocInfo, &cmd) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    if(vkBeginCommandBuffer(cmd, &beginInfo) != VK_SUCCESS) {
+        vkFreeCommandBuffers(device, pool, 1, &cmd);
+        throw std::runtime_error("failed to begin upload command buffer!");
+    }
+
+    return cmd;
+}
+
+/*------------------------------------------------------------------*/
+
+static double
+millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+BufferUploader::BufferUploader(VkDevice device, DeviceMemoryAllocator &allocator,
+                               const VkAllocationCallbacks *pAllocator,
+                               uint32_t graphicsFamily, VkQueue graphicsQueue,
+                               uint32_t transferFamily, VkQueue transferQueue)
+    : device(device),
+      allocator(allocator),
+      pAllocator(pAllocator),
+      graphicsFamily(graphicsFamily),
+      transferFamily(transferFamily),
+      graphicsQueue(graphicsQueue),
+      transferQueue(transferQueue) {
+
+    graphicsPool = createPool(device, graphicsFamily, pAllocator);
+
+    if(transferQueue != VK_NULL_HANDLE && transferFamily != graphicsFamily) {
+        transferPool = createPool(device, transferFamily, pAllocator);
+    }
+    else {
+        this->transferFamily = graphicsFamily;
+        this->transferQueue = graphicsQueue;
+        transferPool = graphicsPool;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+BufferUploader::~BufferUploader() {
+    for(auto &batch : batches) {
+        VkFence fences[] = { batch->transferFence, batch->acquireFence };
+        uint32_t fenceCount = (batch->acquireFence != VK_NULL_HANDLE) ? 2 : 1;
+
+        vkWaitForFences(device, fenceCount, fences, VK_TRUE, UINT64_MAX);
+        release(*batch);
+    }
+
+    if(transferPool != graphicsPool) {
+        vkDestroyCommandPool(device, transferPool, pAllocator);
+    }
+    vkDestroyCommandPool(device, graphicsPool, pAllocator);
+}
+
+/*------------------------------------------------------------------*/
+
+uint64_t
+BufferUploader::submit(const std::vector<Upload> &uploads) {
+    collect();
+
+    uint64_t ticket = nextTicket++;
+
+    auto batch = std::make_unique<Batch>();
+    batch->ticket = ticket;
+
+    for(const auto &upload : uploads) {
+        if(upload.size != 0) {
+            batch->timing.bytes += upload.size;
+            ++batch->timing.buffers;
+        }
+    }
+
+    // nothing to copy, unknown tickets read as handed over
+    if(batch->timing.bytes == 0) {
+        return ticket;
+    }
+
+    // one staging buffer for the batch. The cpu writes it once front to
+    // back, uncached write combined memory is the fastest for that,
+    // coherent saves the flush
+    VkBufferCreateInfo stagingInfo {};
+        stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        stagingInfo.size = batch->timing.bytes;
+        stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        stagingInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    batch->stagingMemory = allocator.createBuffer(stagingInfo,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        batch->staging);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<VkBufferCopy> regions;
+    std::vector<VkBuffer> targets;
+    VkDeviceSize offset = 0;
+
+    for(const auto &upload : uploads) {
+        if(upload.size == 0) {
+            continue;
+        }
+
+        std::memcpy(static_cast<char *>(batch->stagingMemory.mapped) + offset,
+                    upload.data, upload.size);
+
+        VkBufferCopy region {};
+            region.srcOffset = offset;
+            region.dstOffset = 0;
+            region.size = upload.size;
+
+        regions.push_back(region);
+        targets.push_back(upload.buffer);
+        batch->dstStages |= upload.dstStage;
+
+        offset += upload.size;
+    }
+    allocator.flush(batch->stagingMemory);
+
+    batch->timing.stagingMs = millisecondsSince(startTime);
+
+    batch->transferCmd = beginOneTimeCommands(device, transferPool);
+
+    for(size_t i = 0; i < regions.size(); ++i) {
+        vkCmdCopyBuffer(batch->transferCmd, batch->staging, targets[i], 1,
+                        &regions[i]);
+    }
+
+    if(dedicated()) {
+        // release to the graphics family. Its dst half is ignored here, the
+        // acquire in handOver() makes the copies visible to their first use
+        std::vector<VkBufferMemoryBarrier> releaseBarriers;
+
+        for(const auto &upload : uploads) {
+            if(upload.size == 0) {
+                continue;
+            }
+
+            VkBufferMemoryBarrier barrier {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = 0;
+                barrier.srcQueueFamilyIndex = transferFamily;
+                barrier.dstQueueFamilyIndex = graphicsFamily;
+                barrier.buffer = upload.buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+
+            releaseBarriers.push_back(barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = upload.dstAccess;
+
+            batch->acquireBarriers.push_back(barrier);
+        }
+
+        vkCmdPipelineBarrier(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(releaseBarriers.size()),
+                             releaseBarriers.data(),
+                             0, nullptr);
+    }
+    else {
+        // same queue, later submissions are ordered after the copies
+        VkMemoryBarrier barrier {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        for(const auto &upload : uploads) {
+            barrier.dstAccessMask |= upload.dstAccess;
+        }
+
+        vkCmdPipelineBarrier(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             batch->dstStages, 0, 1, &barrier, 0, nullptr,
+                             0, nullptr);
+    }
+
+    if(vkEndCommandBuffer(batch->transferCmd) != VK_SUCCESS) {
+        release(*batch);
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkSemaphoreCreateInfo semaphoreInfo {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch->transferCmd;
+
+    bool ok = vkCreateFence(device, &fenceInfo, pAllocator,
+                            &batch->transferFence) == VK_SUCCESS;
+
+    // the acquire on the graphics queue waits on it
+    if(ok && dedicated()) {
+        ok = vkCreateSemaphore(device, &semaphoreInfo, pAllocator,
+                               &batch->semaphore) == VK_SUCCESS;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch->semaphore;
+    }
+
+    ok = ok && vkQueueSubmit(transferQueue, 1, &submitInfo,
+                             batch->transferFence) == VK_SUCCESS;
+
+    if(!ok) {
+        release(*batch);
+        throw std::runtime_error("failed to submit buffer upload!");
+    }
+
+    batch->submitTime = std::chrono::steady_clock::now();
+    batches.push_back(std::move(batch));
+
+    return ticket;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+BufferUploader::poll(uint64_t ticket, Timing *timing) {
+    collect();
+
+    Batch *batch = findBatch(ticket);
+
+    // unknown tickets were handed over and released already
+    if(batch == nullptr || batch->handedOver) {
+        return true;
+    }
+
+    VkResult result = vkGetFenceStatus(device, batch->transferFence);
+
+    if(result == VK_NOT_READY) {
+        return false;
+    }
+    else if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to upload buffers!");
+    }
+
+    handOver(*batch);
+
+    if(timing != nullptr) {
+        *timing = batch->timing;
+    }
+
+    return true;
+}
+
+/*------------------------------------------------------------------*/
+
+BufferUploader::Timing
+BufferUploader::wait(uint64_t ticket) {
+    Batch *batch = findBatch(ticket);
+
+    if(batch == nullptr || batch->handedOver) {
+        return Timing();
+    }
+
+    if(vkWaitForFences(device, 1, &batch->transferFence, VK_TRUE,
+                       UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to upload buffers!");
+    }
+
+    handOver(*batch);
+
+    return batch->timing;
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+BufferUploader::Batch *
+BufferUploader::findBatch(uint64_t ticket) {
+    for(auto &batch : batches) {
+        if(batch->ticket == ticket) {
+            return batch.get();
+        }
+    }
+
+    return nullptr;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+BufferUploader::handOver(Batch &batch) {
+    batch.timing.transferMs = millisecondsSince(batch.submitTime);
+
+    // the copies are done with it
+    if(batch.staging != VK_NULL_HANDLE) {
+        allocator.destroyBuffer(batch.staging, batch.stagingMemory);
+    }
+
+    if(!dedicated()) {
+        batch.handedOver = true;
+        return;
+    }
+
+    // acquire half of the ownership transfer. The semaphore wait and the
+    // barrier share their stages, so the chain reaches the first use
+    batch.acquireCmd = beginOneTimeCommands(device, graphicsPool);
+
+    vkCmdPipelineBarrier(batch.acquireCmd, batch.dstStages, batch.dstStages, 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(batch.acquireBarriers.size()),
+                         batch.acquireBarriers.data(),
+                         0, nullptr);
+
+    VkFenceCreateInfo fenceInfo {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &batch.semaphore;
+        submitInfo.pWaitDstStageMask = &batch.dstStages;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.acquireCmd;
+
+    bool ok = vkEndCommandBuffer(batch.acquireCmd) == VK_SUCCESS &&
+              vkCreateFence(device, &fenceInfo, pAllocator,
+                            &batch.acquireFence) == VK_SUCCESS &&
+              vkQueueSubmit(graphicsQueue, 1, &submitInfo,
+                            batch.acquireFence) == VK_SUCCESS;
+
+    // still pending, the next poll() or wait() retries the acquire
+    if(!ok) {
+        vkDestroyFence(device, batch.acquireFence, pAllocator);
+        batch.acquireFence = VK_NULL_HANDLE;
+        vkFreeCommandBuffers(device, graphicsPool, 1, &batch.acquireCmd);
+        batch.acquireCmd = VK_NULL_HANDLE;
+
+        throw std::runtime_error("failed to hand buffer uploads over!");
+    }
+
+    batch.handedOver = true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+BufferUploader::collect() {
+    batches.erase(
+        std::remove_if(batches.begin(), batches.end(),
+                       [this](const std::unique_ptr<Batch> &batch) {
+                           if(!batch->handedOver) {
+                               return false;
+                           }
+                           VkFence fence = dedicated() ? batch->acquireFence :
+                                                         batch->transferFence;
+                           if(vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+                               return false;
+                           }
+                           release(*batch);
+                           return true;
+                       }),
+        batches.end());
+}
+
+/*------------------------------------------------------------------*/
+
+void
+BufferUploader::release(Batch &batch) {
+    if(batch.staging != VK_NULL_HANDLE) {
+        allocator.destroyBuffer(batch.staging, batch.stagingMemory);
+    }
+    if(batch.transferCmd != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(device, transferPool, 1, &batch.transferCmd);
+    }
+    if(batch.acquireCmd != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(device, graphicsPool, 1, &batch.acquireCmd);
+    }
+    vkDestroySemaphore(device, batch.semaphore, pAllocator);
+    vkDestroyFence(device, batch.transferFence, pAllocator);
+    vkDestroyFence(device, batch.acquireFence, pAllocator);
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,104 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include "deviceMemory.h"
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Staged buffer uploads on a dedicated transfer queue
+/*------------------------------------------------------------------*/
+
+// Copies host data into device local buffers through a staging buffer, one
+// submission per batch. With a transfer family apart from the graphics one
+// the copies run on its queue, alongside rendering: the transfer submission
+// releases the buffers to the graphics family and signals a semaphore, and
+// once its fence shows the copies done, poll() submits the matching acquire
+// barriers on the graphics queue waiting on that semaphore. Graphics
+// submissions after that may use the buffers. Polling first keeps the
+// graphics queue from ever waiting on the copy. Without a transfer family
+// the same batch is copied on the graphics queue.
+// Not thread safe, use it from the thread submitting to the graphics queue.
+
+class BufferUploader {
+
+    public:
+        struct Upload {
+            VkBuffer buffer;                    // device local, transfer dst
+            const void *data;                   // copied during submit()
+            VkDeviceSize size;
+            VkPipelineStageFlags dstStage;      // first graphics use
+            VkAccessFlags dstAccess;
+        };
+
+        struct Timing {
+            uint32_t buffers = 0;
+            VkDeviceSize bytes = 0;
+            double stagingMs = 0.0;             // host copy into staging
+            double transferMs = 0.0;            // submit until seen complete
+        };
+
+        // transferQueue VK_NULL_HANDLE or transferFamily == graphicsFamily
+        // copies on the graphics queue
+        BufferUploader(VkDevice device, DeviceMemoryAllocator &allocator,
+                       const VkAllocationCallbacks *pAllocator,
+                       uint32_t graphicsFamily, VkQueue graphicsQueue,
+                       uint32_t transferFamily, VkQueue transferQueue);
+        ~BufferUploader();                      // waits for the batches
+
+        BufferUploader(const BufferUploader &) = delete;
+        BufferUploader & operator=(const BufferUploader &) = delete;
+
+        // stages and submits, returns the batch ticket without waiting
+        uint64_t submit(const std::vector<Upload> &uploads);
+
+        // true once graphics submissions made from now on may use the
+        // buffers, timing is filled in the call that hands them over
+        bool poll(uint64_t ticket, Timing *timing = nullptr);
+        Timing wait(uint64_t ticket);           // blocks, startup uploads
+
+        bool dedicated() const { return transferPool != graphicsPool; }
+
+    private:
+        struct Batch {
+            uint64_t ticket = 0;
+            VkBuffer staging = VK_NULL_HANDLE;
+            DeviceMemoryAllocator::Allocation stagingMemory;
+            VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+            VkCommandBuffer acquireCmd = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;     // dedicated only
+            VkFence transferFence = VK_NULL_HANDLE;
+            VkFence acquireFence = VK_NULL_HANDLE;      // dedicated only
+            std::vector<VkBufferMemoryBarrier> acquireBarriers;
+            VkPipelineStageFlags dstStages = 0;
+            bool handedOver = false;
+            std::chrono::steady_clock::time_point submitTime;
+            Timing timing;
+        };
+
+        Batch * findBatch(uint64_t ticket);
+        void handOver(Batch &batch);            // transfer fence signaled
+        void collect();                         // release finished batches
+        void release(Batch &batch);
+
+    private:
+        VkDevice device;
+        DeviceMemoryAllocator &allocator;
+        const VkAllocationCallbacks *pAllocator;
+        uint32_t graphicsFamily;
+        uint32_t transferFamily;
+        VkQueue graphicsQueue;
+        VkQueue transferQueue;
+        VkCommandPool graphicsPool = VK_NULL_HANDLE;
+        VkCommandPool transferPool = VK_NULL_HANDLE;    // == graphicsPool
+                                                        // without a family
+        std::vector<std::unique_ptr<Batch>> batches;    // in flight
+        uint64_t nextTicket = 1;
+};
+
+/*------------------------------------------------------------------*/
@@ -1,4 +1,16 @@
-/usr/local/bin/glslc shaders/shader.vert -o shaders/vert.spv
-/usr/local/bin/glslc shaders/shader.frag -o shaders/frag.spv
-/usr/local/bin/glslc shaders/shader_1.vert -o shaders/vert_01.spv
-/usr/local/bin/glslc shaders/shader_1.frag -o shaders/frag_01.spv
+#!/bin/sh
+# SPIR-V files for the --shader-dir development override. The build embeds
+# the shaders itself (see Makefile), this is only needed to try shader
+# changes without relinking. Goes through spvCompile and its cache, so only
+# changed shaders are compiled; glslc is used unless built with SHADERC=1
+GLSLC=${GLSLC:-/usr/local/bin/glslc}
+export GLSLC
+
+cd "$(dirname "$0")" || exit 1
+
+make -s spvCompile || exit 1
+
+./spvCompile shaders/shader.vert shaders/vert.spv \
+             shaders/shader.frag shaders/frag.spv \
+             shaders/shader_1.vert shaders/vert_01.spv \
+             shaders/shader_1.frag shaders/frag_01.spv
@@ -0,0 +1,256 @@
+#include "deviceCapabilities.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static bool
+extensionNameLess(const VkExtensionProperties &lhs, const char *rhs) {
+    return std::strcmp(lhs.extensionName, rhs) < 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static bool
+checkTimelineSemaphoreSupport(VkInstance instance, VkPhysicalDevice device,
+                              uint32_t instanceApiVersion,
+                              uint32_t deviceApiVersion) {
+    // timeline semaphores are core in vulkan 1.2, both the instance and the
+    // device have to support it
+    if(instanceApiVersion < VK_API_VERSION_1_2 ||
+       deviceApiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    auto func = (PFN_vkGetPhysicalDeviceFeatures2) vkGetInstanceProcAddr(
+                        instance,
+                        "vkGetPhysicalDeviceFeatures2");
+
+    if(func == nullptr) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {};
+        timelineFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timelineFeatures;
+
+    func(device, &features);
+
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+/*------------------------------------------------------------------*/
+
+static QueueFamilyIndices
+findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface,
+                  const std::vector<VkQueueFamilyProperties> &qFamilies) {
+    QueueFamilyIndices indices;
+
+    // Let us iterate over queue families and check if it works for our needs
+
+    for(size_t i = 0; i < qFamilies.size(); ++i) {
+        if(qFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            indices.graphicsFamily = i;
+        }
+
+        // find presentation family. Headless there is nothing to present
+        // to, the graphics family stands in
+        VkBool32 presentSupport = false;
+        if(surface == VK_NULL_HANDLE) {
+            presentSupport = (qFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
+        else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i , surface, &presentSupport);
+        }
+
+        if(presentSupport) {
+            indices.presentFamily = i;
+        }
+
+        if(indices.isComplete()) {
+            #ifndef NDEBUG
+                std::cout << "graphics family: " << indices.graphicsFamily.value()
+                          << std::endl;
+
+                std::cout << "present family: " << indices.presentFamily.value()
+                          << std::endl;
+            #endif
+
+            break;
+        }
+    }
+
+    // copy engines (dma) run uploads alongside rendering. A transfer only
+    // family is preferred, an async compute family still does the copies
+    // off the graphics queue
+    for(size_t i = 0; i < qFamilies.size(); ++i) {
+        VkQueueFlags flags = qFamilies[i].queueFlags;
+
+        if((flags & VK_QUEUE_GRAPHICS_BIT) || !(flags & VK_QUEUE_TRANSFER_BIT)) {
+            continue;
+        }
+
+        if(!indices.transferFamily.has_value() ||
+           !(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily = i;
+        }
+
+        if(!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            break;
+        }
+    }
+
+    #ifndef NDEBUG
+        if(indices.transferFamily.has_value()) {
+            std::cout << "transfer family: " << indices.transferFamily.value()
+                      << std::endl;
+        }
+    #endif
+
+    return indices;
+}
+
+/*------------------------------------------------------------------*/
+
+static SwapchainSupportDetails
+querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    //most swapchain queries take device and surface as first two parameters
+    // let us query capabilities
+
+    SwapchainSupportDetails details;
+
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device,
+                                             surface,
+                                             &details.capabilities);
+
+    #ifndef NDEBUG
+        std::cout << INTENT_STR << "surface capabilities" << std::endl;
+
+        std::cout << INTENT_SPACE << INTENT_STR << "minImageCount: "
+                  << details.capabilities.minImageCount << std::endl;
+
+        std::cout << INTENT_SPACE << INTENT_STR << "maxImageCount: "
+                  << details.capabilities.maxImageCount << std::endl;
+    #endif
+
+    // query for supported surface formats
+    uint32_t formatCnt;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCnt, nullptr);
+
+    if(formatCnt != 0) {
+        details.formats.resize(formatCnt);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCnt,
+                                            details.formats.data());
+    }
+
+    // query for present mode
+    uint32_t presentModeCnt;
+
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCnt,
+                                              nullptr);
+
+    if(presentModeCnt != 0) {
+        details.presentModes.resize(presentModeCnt);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface,
+                 &presentModeCnt, details.presentModes.data());
+    }
+
+    return details;
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+DeviceCapabilities
+DeviceCapabilities::query(VkInstance instance, uint32_t instanceApiVersion,
+                          VkPhysicalDevice device, VkSurfaceKHR surface) {
+    DeviceCapabilities caps;
+
+    caps.physicalDevice = device;
+
+    vkGetPhysicalDeviceProperties(device, &caps.properties);
+    vkGetPhysicalDeviceFeatures(device, &caps.features);
+    vkGetPhysicalDeviceMemoryProperties(device, &caps.memoryProperties);
+
+    caps.timelineSemaphores = checkTimelineSemaphoreSupport(instance, device,
+                                                instanceApiVersion,
+                                                caps.properties.apiVersion);
+
+    // queue families
+    uint32_t qFamilyCnt = 0;
+
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &qFamilyCnt, nullptr);
+
+    if(qFamilyCnt == 0) {
+        throw std::runtime_error("No queue family properties found");
+    }
+
+    caps.queueFamilies.resize(qFamilyCnt);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &qFamilyCnt,
+                                             caps.queueFamilies.data());
+
+    caps.queueFamilyIndices = findQueueFamilies(device, surface,
+                                                caps.queueFamilies);
+
+    // device extensions, sorted once so lookups are a binary search
+    uint32_t extCnt = 0;
+
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extCnt, nullptr);
+
+    caps.extensions.resize(extCnt);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extCnt,
+                                         caps.extensions.data());
+
+    std::sort(caps.extensions.begin(), caps.extensions.end(),
+              [](const VkExtensionProperties &lhs, const VkExtensionProperties &rhs) {
+                  return std::strcmp(lhs.extensionName, rhs.extensionName) < 0;
+              });
+
+    #ifndef NDEBUG
+        for(const auto &e : caps.extensions) {
+            std::cout << INTENT_SPACE << INTENT_STR << e.extensionName
+                      << std::endl;
+        }
+    #endif
+
+    // surface queries need the swapchain extension
+    if(surface != VK_NULL_HANDLE &&
+       caps.hasExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+        caps.swapchainSupport = querySwapchainSupport(device, surface);
+    }
+
+    return caps;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceCapabilities::refreshSurfaceCapabilities(VkSurfaceKHR surface) {
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
+                                              &swapchainSupport.capabilities);
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+DeviceCapabilities::hasExtension(const char *name) const {
+    auto it = std::lower_bound(extensions.begin(), extensions.end(), name,
+                               extensionNameLess);
+
+    return it != extensions.end() && std::strcmp(it->extensionName, name) == 0;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,66 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Physical device capability snapshot
+/*------------------------------------------------------------------*/
+
+struct QueueFamilyIndices {
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily;     // without graphics, optional
+
+    bool isComplete() const {
+        return graphicsFamily.has_value() && presentFamily.has_value();
+    }
+};
+
+struct SwapchainSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities {};
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> presentModes;
+};
+
+// Everything startup and swapchain creation need to know about a physical
+// device, queried once with query() and read from then on. Only the surface
+// capabilities (current extent, transform) change over the lifetime of a
+// surface, refreshSurfaceCapabilities() re-queries just those on swapchain
+// recreation.
+
+struct DeviceCapabilities {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+    VkPhysicalDeviceProperties properties {};
+    VkPhysicalDeviceFeatures features {};
+    VkPhysicalDeviceMemoryProperties memoryProperties {};
+    bool timelineSemaphores = false;    // vulkan 1.2 instance and device
+
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    QueueFamilyIndices queueFamilyIndices;
+
+    // sorted by name, see hasExtension()
+    std::vector<VkExtensionProperties> extensions;
+
+    // empty without a surface (headless)
+    SwapchainSupportDetails swapchainSupport;
+
+    // surface may be VK_NULL_HANDLE, the graphics family then stands in for
+    // the present family and no surface details are queried
+    static DeviceCapabilities query(VkInstance instance,
+                                    uint32_t instanceApiVersion,
+                                    VkPhysicalDevice device,
+                                    VkSurfaceKHR surface);
+
+    void refreshSurfaceCapabilities(VkSurfaceKHR surface);
+
+    // binary search, no allocation
+    bool hasExtension(const char *name) const;
+};
+
+/*------------------------------------------------------------------*/
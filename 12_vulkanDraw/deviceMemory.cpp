@@ -0,0 +1,672 @@
+#include "deviceMemory.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+static const double MIB = 1024.0 * 1024.0;
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static VkDeviceSize
+floorPow2(VkDeviceSize value) {
+    VkDeviceSize result = 1;
+    while(result <= value / 2) {
+        result *= 2;
+    }
+    return result;
+}
+
+/*------------------------------------------------------------------*/
+
+static VkDeviceSize
+ceilPow2(VkDeviceSize value) {
+    VkDeviceSize result = 1;
+    while(result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+/*------------------------------------------------------------------*/
+
+// node order of a power of two size, MIN_NODE_SIZE is order 0
+static uint32_t
+orderOf(VkDeviceSize nodeSize) {
+    uint32_t order = 0;
+    while((DeviceMemoryAllocator::MIN_NODE_SIZE << order) < nodeSize) {
+        ++order;
+    }
+    return order;
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+double
+DeviceMemoryAllocator::Stats::fragmentation() const {
+    return freeBytes == 0 ? 0.0 :
+           1.0 - static_cast<double>(largestFreeNode) / freeBytes;
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice device,
+                                             const DeviceCapabilities &caps,
+                                             const VkAllocationCallbacks *pAllocator,
+                                             VkDeviceSize blockSize)
+    : device(device),
+      pAllocator(pAllocator),
+      memoryProperties(caps.memoryProperties),
+      maxDeviceAllocations(caps.properties.limits.maxMemoryAllocationCount),
+      nonCoherentAtomSize(std::max<VkDeviceSize>(
+                            caps.properties.limits.nonCoherentAtomSize, 1)),
+      blockSize(floorPow2(std::max(blockSize != 0 ? blockSize : DEFAULT_BLOCK_SIZE,
+                                   MIN_NODE_SIZE))) {
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator() {
+    // anything still live is a leak of the caller, the memory goes anyway
+    for(auto &entry : records) {
+        if(entry.second.block == nullptr) {
+            vkFreeMemory(device, entry.second.allocation.memory, pAllocator);
+        }
+    }
+
+    for(auto &block : blocks) {
+        vkFreeMemory(device, block->memory, pAllocator);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::Allocation
+DeviceMemoryAllocator::allocate(const VkMemoryRequirements &requirements,
+                                VkMemoryPropertyFlags required,
+                                VkMemoryPropertyFlags preferred, Kind kind) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits,
+                                         required, preferred);
+
+    Allocation allocation;
+        allocation.size = requirements.size;
+        allocation.flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+        allocation.id = nextId++;
+
+    Record record;
+
+    // buddy nodes are aligned to their size
+    VkDeviceSize nodeSize = ceilPow2(std::max({ requirements.size,
+                                                requirements.alignment,
+                                                MIN_NODE_SIZE }));
+
+    if(nodeSize > blockSizeFor(memoryType) / 2) {
+        char *mapped = nullptr;
+        allocation.memory = allocateDeviceMemory(memoryType, requirements.size,
+                                                 &mapped);
+
+        if(allocation.memory == VK_NULL_HANDLE) {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+
+        allocation.mapped = mapped;
+        allocation.dedicated = true;
+    }
+    else {
+        uint32_t order = orderOf(nodeSize);
+        VkDeviceSize offset = 0;
+        Block *target = nullptr;
+
+        for(auto &block : blocks) {
+            if(block->memoryType == memoryType && block->kind == kind &&
+               allocateNode(*block, order, offset)) {
+                target = block.get();
+                break;
+            }
+        }
+
+        if(target == nullptr) {
+            target = createBlock(memoryType, kind, nodeSize);
+
+            if(target == nullptr || !allocateNode(*target, order, offset)) {
+                throw std::runtime_error("failed to allocate device memory block!");
+            }
+        }
+
+        target->usedBytes += requirements.size;
+        ++target->allocations;
+
+        allocation.memory = target->memory;
+        allocation.offset = offset;
+        allocation.mapped = target->mapped != nullptr ? target->mapped + offset :
+                                                        nullptr;
+        record.block = target;
+        record.order = order;
+    }
+
+    record.allocation = allocation;
+    records.emplace(allocation.id, record);
+
+    return allocation;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::free(Allocation &allocation) {
+    if(allocation.id == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = records.find(allocation.id);
+    if(it == records.end()) {
+        throw std::runtime_error("freeing unknown device memory allocation!");
+    }
+
+    Record &record = it->second;
+
+    if(record.block == nullptr) {
+        vkFreeMemory(device, record.allocation.memory, pAllocator);
+        --deviceAllocations;
+    }
+    else {
+        Block &block = *record.block;
+
+        freeNode(block, record.allocation.offset, record.order);
+        block.usedBytes -= record.allocation.size;
+        --block.allocations;
+    }
+
+    bool blockEmptied = record.block != nullptr && record.block->allocations == 0;
+
+    records.erase(it);
+    allocation = Allocation();
+
+    // one spare block per memory type and kind, so a resource recreated
+    // every resize does not allocate and free a block each time
+    if(blockEmptied) {
+        releaseEmptyBlocks(true);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::Allocation
+DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo &bufferInfo,
+                                    VkMemoryPropertyFlags required,
+                                    VkMemoryPropertyFlags preferred,
+                                    VkBuffer &buffer) {
+    if(vkCreateBuffer(device, &bufferInfo, pAllocator, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    Allocation allocation;
+
+    try {
+        allocation = allocate(memRequirements, required, preferred, Kind::Linear);
+    } catch(...) {
+        vkDestroyBuffer(device, buffer, pAllocator);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+    return allocation;
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::Allocation
+DeviceMemoryAllocator::createImage(const VkImageCreateInfo &imageInfo,
+                                   VkMemoryPropertyFlags required,
+                                   VkMemoryPropertyFlags preferred,
+                                   VkImage &image) {
+    if(vkCreateImage(device, &imageInfo, pAllocator, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    Kind kind = (imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL) ? Kind::Optimal :
+                                                                Kind::Linear;
+    Allocation allocation;
+
+    try {
+        allocation = allocate(memRequirements, required, preferred, kind);
+    } catch(...) {
+        vkDestroyImage(device, image, pAllocator);
+        image = VK_NULL_HANDLE;
+        throw;
+    }
+
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+
+    return allocation;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::destroyBuffer(VkBuffer &buffer, Allocation &allocation) {
+    vkDestroyBuffer(device, buffer, pAllocator);
+    buffer = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::destroyImage(VkImage &image, Allocation &allocation) {
+    vkDestroyImage(device, image, pAllocator);
+    image = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::flush(const Allocation &allocation) const {
+    flush(allocation, 0, allocation.size);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::flush(const Allocation &allocation, VkDeviceSize offset,
+                             VkDeviceSize size) const {
+    if(allocation.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT || size == 0) {
+        return;
+    }
+
+    VkMappedMemoryRange range {};
+    mappedRange(allocation, offset, size, range);
+    vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::invalidate(const Allocation &allocation) const {
+    if(allocation.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+        return;
+    }
+
+    VkMappedMemoryRange range {};
+    mappedRange(allocation, 0, allocation.size, range);
+    vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+/*------------------------------------------------------------------*/
+
+uint32_t
+DeviceMemoryAllocator::defragment(const MoveCallback &move, uint32_t maxMoves) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // drain the emptiest blocks first, into blocks fuller than themselves
+    std::vector<Block *> order;
+    for(auto &block : blocks) {
+        order.push_back(block.get());
+    }
+    std::sort(order.begin(), order.end(), [](const Block *lhs, const Block *rhs) {
+        return lhs->usedBytes < rhs->usedBytes;
+    });
+
+    uint32_t moves = 0;
+
+    for(Block *source : order) {
+        for(auto &entry : records) {
+            Record &record = entry.second;
+
+            if(moves >= maxMoves) {
+                break;
+            }
+            if(record.block != source) {
+                continue;
+            }
+
+            for(Block *target : order) {
+                VkDeviceSize offset = 0;
+
+                if(target == source || target->memoryType != source->memoryType ||
+                   target->kind != source->kind ||
+                   target->usedBytes <= source->usedBytes ||
+                   !allocateNode(*target, record.order, offset)) {
+                    continue;
+                }
+
+                Allocation to = record.allocation;
+                    to.memory = target->memory;
+                    to.offset = offset;
+                    to.mapped = target->mapped != nullptr ? target->mapped + offset :
+                                                            nullptr;
+
+                if(!move(record.allocation, to)) {
+                    freeNode(*target, offset, record.order);
+                    break;
+                }
+
+                freeNode(*source, record.allocation.offset, record.order);
+                source->usedBytes -= to.size;
+                --source->allocations;
+                target->usedBytes += to.size;
+                ++target->allocations;
+
+                record.block = target;
+                record.allocation = to;
+                ++moves;
+                break;
+            }
+        }
+    }
+
+    releaseEmptyBlocks(false);
+
+    return moves;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::freeEmptyBlocks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseEmptyBlocks(false);
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::Stats
+DeviceMemoryAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats result;
+        result.deviceAllocations = deviceAllocations;
+        result.maxDeviceAllocations = maxDeviceAllocations;
+        result.blocks = static_cast<uint32_t>(blocks.size());
+        result.allocations = records.size();
+
+    for(const auto &entry : records) {
+        if(entry.second.block == nullptr) {
+            ++result.dedicated;
+            result.dedicatedBytes += entry.second.allocation.size;
+        }
+    }
+
+    for(const auto &block : blocks) {
+        result.blockBytes += block->size;
+        result.usedBytes += block->usedBytes;
+
+        for(uint32_t order = 0; order <= block->maxOrder; ++order) {
+            VkDeviceSize nodeSize = MIN_NODE_SIZE << order;
+
+            result.freeBytes += nodeSize * block->freeNodes[order].size();
+            if(!block->freeNodes[order].empty()) {
+                result.largestFreeNode = std::max(result.largestFreeNode, nodeSize);
+            }
+        }
+    }
+
+    return result;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::print() const {
+    Stats total = stats();
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << INTENT_STR << "Device memory" << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "vkAllocateMemory live: "
+              << total.deviceAllocations << " of " << total.maxDeviceAllocations
+              << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "allocations: "
+              << total.allocations << " (" << total.dedicated << " dedicated, "
+              << std::fixed << std::setprecision(2)
+              << total.dedicatedBytes / MIB << " MiB)" << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "blocks: " << total.blocks
+              << " holding " << total.blockBytes / MIB << " MiB, used "
+              << total.usedBytes / MIB << " MiB, free "
+              << total.freeBytes / MIB << " MiB, largest free node "
+              << total.largestFreeNode / MIB << " MiB, fragmentation "
+              << 100.0 * total.fragmentation() << "%" << std::endl;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for(const auto &block : blocks) {
+        std::cout << INTENT_SPACE << INTENT_SPACE << INTENT_STR << "type "
+                  << block->memoryType
+                  << (block->kind == Kind::Optimal ? " optimal " : " linear ")
+                  << block->size / MIB << " MiB block: "
+                  << block->allocations << " allocations, "
+                  << block->usedBytes / MIB << " MiB used" << std::endl;
+    }
+
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+uint32_t
+DeviceMemoryAllocator::findMemoryType(uint32_t typeBits,
+                                      VkMemoryPropertyFlags required,
+                                      VkMemoryPropertyFlags preferred) const {
+    VkMemoryPropertyFlags wanted[] = { required | preferred, required };
+
+    for(VkMemoryPropertyFlags flags : wanted) {
+        for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            if((typeBits & (1u << i)) &&
+               (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+                return i;
+            }
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+/*------------------------------------------------------------------*/
+
+// VK_NULL_HANDLE when the driver is out of memory or allocations
+VkDeviceMemory
+DeviceMemoryAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size,
+                                            char **mapped) {
+    if(deviceAllocations >= maxDeviceAllocations) {
+        return VK_NULL_HANDLE;
+    }
+
+    VkMemoryAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+
+    if(vkAllocateMemory(device, &allocInfo, pAllocator, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+
+    *mapped = nullptr;
+
+    // mapped once for the lifetime of the memory
+    if(memoryProperties.memoryTypes[memoryType].propertyFlags &
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void *data = nullptr;
+
+        if(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, pAllocator);
+            return VK_NULL_HANDLE;
+        }
+        *mapped = static_cast<char *>(data);
+    }
+
+    ++deviceAllocations;
+
+    return memory;
+}
+
+/*------------------------------------------------------------------*/
+
+DeviceMemoryAllocator::Block *
+DeviceMemoryAllocator::createBlock(uint32_t memoryType, Kind kind,
+                                   VkDeviceSize minSize) {
+    // halve on failure, a nearly full heap may still fit a smaller block
+    for(VkDeviceSize size = std::max(blockSizeFor(memoryType), minSize);
+        size >= minSize; size /= 2) {
+        char *mapped = nullptr;
+        VkDeviceMemory memory = allocateDeviceMemory(memoryType, size, &mapped);
+
+        if(memory == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        auto block = std::make_unique<Block>();
+            block->memory = memory;
+            block->size = size;
+            block->memoryType = memoryType;
+            block->kind = kind;
+            block->mapped = mapped;
+            block->maxOrder = orderOf(size);
+            block->freeNodes.resize(block->maxOrder + 1);
+            block->freeNodes[block->maxOrder].insert(0);
+
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    return nullptr;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+DeviceMemoryAllocator::allocateNode(Block &block, uint32_t order,
+                                    VkDeviceSize &offset) {
+    if(order > block.maxOrder) {
+        return false;
+    }
+
+    // smallest free node that fits, split down to the requested order
+    uint32_t found = order;
+    while(found <= block.maxOrder && block.freeNodes[found].empty()) {
+        ++found;
+    }
+
+    if(found > block.maxOrder) {
+        return false;
+    }
+
+    offset = *block.freeNodes[found].begin();
+    block.freeNodes[found].erase(block.freeNodes[found].begin());
+
+    while(found > order) {
+        --found;
+        block.freeNodes[found].insert(offset + (MIN_NODE_SIZE << found));
+    }
+
+    return true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::freeNode(Block &block, VkDeviceSize offset, uint32_t order) {
+    // merge with the buddy for as long as it is free too
+    while(order < block.maxOrder) {
+        VkDeviceSize buddy = offset ^ (MIN_NODE_SIZE << order);
+
+        if(block.freeNodes[order].erase(buddy) == 0) {
+            break;
+        }
+
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+
+    block.freeNodes[order].insert(offset);
+}
+
+/*------------------------------------------------------------------*/
+
+// caller holds mutex
+void
+DeviceMemoryAllocator::releaseEmptyBlocks(bool keepOne) {
+    std::vector<std::pair<uint32_t, Kind>> kept;
+
+    for(auto it = blocks.begin(); it != blocks.end(); ) {
+        Block &block = **it;
+        std::pair<uint32_t, Kind> key(block.memoryType, block.kind);
+
+        if(block.allocations != 0 ||
+           (keepOne && std::find(kept.begin(), kept.end(), key) == kept.end())) {
+            if(block.allocations == 0) {
+                kept.push_back(key);
+            }
+            ++it;
+            continue;
+        }
+
+        vkFreeMemory(device, block.memory, pAllocator);
+        --deviceAllocations;
+        it = blocks.erase(it);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+VkDeviceSize
+DeviceMemoryAllocator::blockSizeFor(uint32_t memoryType) const {
+    // small heaps (integrated gpus, the 256 MiB bar window) get smaller
+    // blocks so one block does not claim a large share of the heap
+    uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+    VkDeviceSize heapShare = floorPow2(std::max(memoryProperties.memoryHeaps[heap].size / 8,
+                                                MIN_NODE_SIZE));
+
+    return std::min(blockSize, heapShare);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+DeviceMemoryAllocator::mappedRange(const Allocation &allocation,
+                                   VkDeviceSize offset, VkDeviceSize size,
+                                   VkMappedMemoryRange &range) const {
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+
+    // atom aligned. Block allocations stay inside the node since nodes are
+    // at least MIN_NODE_SIZE aligned and sized, dedicated ones run to the
+    // end of the memory rather than past it
+    VkDeviceSize begin = allocation.offset + offset;
+    range.offset = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+
+    if(allocation.dedicated) {
+        range.size = VK_WHOLE_SIZE;
+        return;
+    }
+
+    VkDeviceSize end = begin + size;
+    range.size = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize *
+                 nonCoherentAtomSize - range.offset;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,158 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include "deviceCapabilities.h"
+
+#include <set>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Device memory sub-allocator
+/*------------------------------------------------------------------*/
+
+// Buffers and images share a few large VkDeviceMemory blocks instead of one
+// vkAllocateMemory each, drivers limit the count (maxMemoryAllocationCount,
+// often 4096) and every allocation is a kernel round trip. Blocks are split
+// by buddy allocation in power of two nodes, which are naturally aligned to
+// their size, so any alignment up to the node size holds. Linear (buffers,
+// linear images) and optimal tiling images never share a block, which keeps
+// them bufferImageGranularity apart without padding. Requests over half a
+// block get a dedicated allocation. Host visible blocks stay mapped.
+// Thread safe.
+
+class DeviceMemoryAllocator {
+
+    public:
+        static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize MIN_NODE_SIZE = 256;  // >= nonCoherentAtomSize
+
+        enum class Kind { Linear, Optimal };
+
+        struct Allocation {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = 0;          // requested
+            void *mapped = nullptr;         // host visible memory only
+            VkMemoryPropertyFlags flags = 0;
+            bool dedicated = false;         // owns all of memory
+            uint64_t id = 0;                // 0 = no allocation
+        };
+
+        struct Stats {
+            uint32_t deviceAllocations = 0;     // live vkAllocateMemory
+            uint32_t maxDeviceAllocations = 0;  // maxMemoryAllocationCount
+            uint32_t blocks = 0;
+            uint64_t allocations = 0;
+            uint64_t dedicated = 0;
+            VkDeviceSize dedicatedBytes = 0;
+            VkDeviceSize blockBytes = 0;        // held in blocks
+            VkDeviceSize usedBytes = 0;         // requested, blocks only
+            VkDeviceSize freeBytes = 0;         // free nodes in blocks
+            VkDeviceSize largestFreeNode = 0;
+
+            // share of free block memory outside the largest free node,
+            // 0 = one contiguous free range
+            double fragmentation() const;
+        };
+
+        // copy the contents of from into to and rebind the resource, return
+        // false to keep it where it is. See defragment()
+        using MoveCallback = std::function<bool(const Allocation &from,
+                                                const Allocation &to)>;
+
+        // blockSize 0 picks DEFAULT_BLOCK_SIZE, capped at 1/8 of small heaps
+        DeviceMemoryAllocator(VkDevice device, const DeviceCapabilities &caps,
+                              const VkAllocationCallbacks *pAllocator,
+                              VkDeviceSize blockSize = 0);
+        ~DeviceMemoryAllocator();
+
+        DeviceMemoryAllocator(const DeviceMemoryAllocator &) = delete;
+        DeviceMemoryAllocator & operator=(const DeviceMemoryAllocator &) = delete;
+
+        // memory type with required and preferred flags, else with required
+        // only. Throws std::runtime_error when nothing fits
+        Allocation allocate(const VkMemoryRequirements &requirements,
+                            VkMemoryPropertyFlags required,
+                            VkMemoryPropertyFlags preferred, Kind kind);
+        void free(Allocation &allocation);
+
+        // create, allocate and bind in one step
+        Allocation createBuffer(const VkBufferCreateInfo &bufferInfo,
+                                VkMemoryPropertyFlags required,
+                                VkMemoryPropertyFlags preferred, VkBuffer &buffer);
+        Allocation createImage(const VkImageCreateInfo &imageInfo,
+                               VkMemoryPropertyFlags required,
+                               VkMemoryPropertyFlags preferred, VkImage &image);
+        void destroyBuffer(VkBuffer &buffer, Allocation &allocation);
+        void destroyImage(VkImage &image, Allocation &allocation);
+
+        // no-ops on host coherent memory
+        void flush(const Allocation &allocation) const;
+        void flush(const Allocation &allocation, VkDeviceSize offset,
+                   VkDeviceSize size) const;   // relative to allocation
+        void invalidate(const Allocation &allocation) const;
+
+        // moves allocations out of the emptiest blocks into fuller ones of the
+        // same memory type and kind, at most maxMoves, then frees blocks left
+        // empty. Returns the number of allocations moved. move runs with the
+        // allocator locked and must not call back into it
+        uint32_t defragment(const MoveCallback &move, uint32_t maxMoves);
+        void freeEmptyBlocks();
+
+        Stats stats() const;
+        void print() const;     // per memory type
+
+    private:
+        struct Block {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            uint32_t memoryType = 0;
+            Kind kind = Kind::Linear;
+            char *mapped = nullptr;
+            uint32_t maxOrder = 0;                      // size = MIN_NODE_SIZE << maxOrder
+            std::vector<std::set<VkDeviceSize>> freeNodes;  // offsets per order
+            VkDeviceSize usedBytes = 0;
+            uint32_t allocations = 0;
+        };
+
+        struct Record {
+            Block *block = nullptr;         // nullptr = dedicated
+            uint32_t order = 0;
+            Allocation allocation;
+        };
+
+        uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                                VkMemoryPropertyFlags preferred) const;
+        VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size,
+                                            char **mapped);
+        Block * createBlock(uint32_t memoryType, Kind kind, VkDeviceSize minSize);
+        bool allocateNode(Block &block, uint32_t order, VkDeviceSize &offset);
+        void freeNode(Block &block, VkDeviceSize offset, uint32_t order);
+        void releaseEmptyBlocks(bool keepOne);
+        VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+        void mappedRange(const Allocation &allocation, VkDeviceSize offset,
+                         VkDeviceSize size, VkMappedMemoryRange &range) const;
+
+    private:
+        VkDevice device;
+        const VkAllocationCallbacks *pAllocator;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        uint32_t maxDeviceAllocations;
+        VkDeviceSize nonCoherentAtomSize;
+        VkDeviceSize blockSize;
+
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Block>> blocks;
+        std::unordered_map<uint64_t, Record> records;   // live, by id
+        uint64_t nextId = 1;
+        uint32_t deviceAllocations = 0;
+};
+
+/*------------------------------------------------------------------*/
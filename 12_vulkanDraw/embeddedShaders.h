@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// SPIR-V embedded at build time
+/*------------------------------------------------------------------*/
+
+// The Makefile generates each .spv.inc with spvCompile, which compiles the
+// shader through ShaderCompiler and its cache and writes the SPIR-V words
+// as a comma separated list, the layout of glslc -mfmt=num. Being uint32_t
+// arrays they are aligned for VkShaderModuleCreateInfo::pCode, and no file
+// has to be found relative to the working directory at startup.
+
+inline constexpr uint32_t EMBEDDED_VERT_SPV[] = {
+    #include "shaders/vert.spv.inc"
+};
+
+inline constexpr uint32_t EMBEDDED_FRAG_SPV[] = {
+    #include "shaders/frag.spv.inc"
+};
+
+// shader_1.vert/shader_1.frag, per vertex colors
+inline constexpr uint32_t EMBEDDED_VERT_01_SPV[] = {
+    #include "shaders/vert_01.spv.inc"
+};
+
+inline constexpr uint32_t EMBEDDED_FRAG_01_SPV[] = {
+    #include "shaders/frag_01.spv.inc"
+};
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,117 @@
+#include "fileView.h"
+
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*------------------------------------------------------------------*/
+
+static int
+adviceFor(FileView::Access access) {
+    switch(access) {
+        case FileView::Access::Sequential:  return MADV_SEQUENTIAL;
+        case FileView::Access::Random:      return MADV_RANDOM;
+        case FileView::Access::WillNeed:    return MADV_WILLNEED;
+    }
+    return MADV_NORMAL;
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+FileView::FileView(const std::string &path, Access access) {
+    if(!map(path, access)) {
+        throw std::runtime_error("failed to map " + path + ": " +
+                                 std::strerror(errno));
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+FileView::~FileView() {
+    unmap();
+}
+
+/*------------------------------------------------------------------*/
+
+FileView::FileView(FileView &&other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)),
+      length(std::exchange(other.length, 0)) {
+}
+
+/*------------------------------------------------------------------*/
+
+FileView &
+FileView::operator=(FileView &&other) noexcept {
+    if(this != &other) {
+        unmap();
+        mapping = std::exchange(other.mapping, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+FileView::map(const std::string &path, Access access) {
+    unmap();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if(::fstat(fd, &fileStat) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    // mmap rejects zero length, an empty file is an empty view
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    if(fileSize == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void *addr = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file
+    int error = errno;
+    ::close(fd);
+
+    if(addr == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+
+    // only a hint, failure is harmless
+    ::madvise(addr, fileSize, adviceFor(access));
+
+    mapping = addr;
+    length = fileSize;
+    return true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+FileView::unmap() {
+    if(mapping != nullptr) {
+        ::munmap(mapping, length);
+    }
+    mapping = nullptr;
+    length = 0;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/*------------------------------------------------------------------*/
+// Memory mapped read-only file view
+/*------------------------------------------------------------------*/
+
+// Maps a whole file read-only instead of copying it into a buffer. The
+// mapping is page aligned, so the contents can be handed straight to apis
+// that need aligned data (e.g. spir-v words for vkCreateShaderModule). The
+// view owns the mapping and unmaps it on destruction; it can be moved but
+// not copied.
+
+class FileView {
+
+    public:
+        // access pattern hint passed to madvise
+        enum class Access {
+            Sequential,     // read front to back once (shaders, caches)
+            Random,         // scattered reads, no readahead
+            WillNeed        // read everything soon, start paging in now
+        };
+
+        FileView() = default;
+
+        // throws std::runtime_error if the file cannot be mapped
+        explicit FileView(const std::string &path,
+                          Access access = Access::Sequential);
+        ~FileView();
+
+        FileView(FileView &&other) noexcept;
+        FileView & operator=(FileView &&other) noexcept;
+
+        FileView(const FileView &) = delete;
+        FileView & operator=(const FileView &) = delete;
+
+        // map path, releasing any current mapping. Returns false with errno
+        // set if the file cannot be opened or mapped
+        bool map(const std::string &path, Access access = Access::Sequential);
+        void unmap();
+
+        const void * data() const { return mapping; }
+        size_t size() const { return length; }
+        bool empty() const { return length == 0; }
+
+        // contents as an array of T, the mapping is page aligned
+        template<typename T>
+        const T * as() const { return static_cast<const T *>(mapping); }
+
+    private:
+        void *mapping = nullptr;        // nullptr for empty files
+        size_t length = 0;
+};
+
+/*------------------------------------------------------------------*/
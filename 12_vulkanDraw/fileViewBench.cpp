@@ -0,0 +1,169 @@
+// microbenchmark: FileView against the ifstream based readFile it replaced
+//
+//      fileViewBench [dir] [iterations]
+//
+// writes test files of 1 KB up to 1 GB into dir (default /tmp), then times
+// opening and reading every byte of each file both ways. Files are read
+// from the page cache after the first iteration, run as root with
+// "echo 3 > /proc/sys/vm/drop_caches" between runs for cold numbers
+
+#include "fileView.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+/*------------------------------------------------------------------*/
+
+// the previous readFile: ifstream, tellg and a full copy
+static std::vector<char>
+readFile(const std::string &filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if(!file.is_open()) {
+        throw std::runtime_error("failed to open " + filename);
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    file.close();
+
+    return buffer;
+}
+
+/*------------------------------------------------------------------*/
+
+// touch every byte so both variants really read the file
+static uint64_t
+checksum(const char *data, size_t size) {
+    uint64_t sum = 0;
+    size_t words = size / sizeof(uint64_t);
+
+    for(size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(word));
+        sum += word;
+    }
+    for(size_t i = words * sizeof(uint64_t); i < size; ++i) {
+        sum += static_cast<unsigned char>(data[i]);
+    }
+
+    return sum;
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+writeTestFile(const std::string &path, size_t size) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::vector<char> chunk(1 << 20);
+
+    for(size_t i = 0; i < chunk.size(); ++i) {
+        chunk[i] = static_cast<char>(i * 131);
+    }
+
+    for(size_t written = 0; written < size; written += chunk.size()) {
+        file.write(chunk.data(), std::min(chunk.size(), size - written));
+    }
+
+    if(!file) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+template<typename Fn>
+static double
+timeMs(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < iterations; ++i) {
+        fn();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed =
+                        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+/*------------------------------------------------------------------*/
+
+int
+main(int argc, char *argv[]) {
+    std::string dir = (argc > 1) ? argv[1] : "/tmp";
+    int iterations = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+    // timeMs() divides by it
+    if(iterations < 1) {
+        std::cerr << "usage: " << argv[0] << " [dir] [iterations >= 1]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const size_t KB = 1024;
+    const size_t sizes[] = { KB, 64 * KB, KB * KB, 16 * KB * KB,
+                             256 * KB * KB, KB * KB * KB };
+
+    try {
+        for(size_t size : sizes) {
+            std::string path = dir + "/fileViewBench_" + std::to_string(size) + ".bin";
+            writeTestFile(path, size);
+
+            // large files get fewer rounds
+            int rounds = (size >= 256 * KB * KB) ? 1 : iterations;
+            uint64_t readSum = 0;
+            uint64_t viewSum = 0;
+
+            // warm the page cache so both start from the same state
+            readSum = checksum(readFile(path).data(), size);
+
+            double readMs = timeMs(rounds, [&]() {
+                std::vector<char> data = readFile(path);
+                readSum = checksum(data.data(), data.size());
+            });
+
+            double viewMs = timeMs(rounds, [&]() {
+                FileView view(path, FileView::Access::Sequential);
+                viewSum = checksum(view.as<char>(), view.size());
+            });
+
+            std::remove(path.c_str());
+
+            if(readSum != viewSum) {
+                throw std::runtime_error("checksum mismatch for " + path);
+            }
+
+            double mb = static_cast<double>(size) / (KB * KB);
+
+            std::cout << INTENT_STR << size / KB << " KB" << std::endl;
+            std::cout << INTENT_SPACE << INTENT_STR << "readFile (ms): " << readMs
+                      << " (" << mb / readMs * 1000.0 << " MB/s, "
+                      << mb << " MB heap copy)" << std::endl;
+            std::cout << INTENT_SPACE << INTENT_STR << "FileView (ms): " << viewMs
+                      << " (" << mb / viewMs * 1000.0 << " MB/s, no copy)"
+                      << std::endl;
+        }
+    } catch(const std::exception & e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
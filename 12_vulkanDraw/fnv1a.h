@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// FNV-1a 64 bit hash
+/*------------------------------------------------------------------*/
+
+// Checksums and cache keys, not for anything adversarial. Pass the previous
+// result as seed to hash several pieces as one.
+
+static const uint64_t FNV1A_OFFSET = 14695981039346656037ull;
+
+inline uint64_t
+fnv1aHash(const void *data, size_t size, uint64_t hash = FNV1A_OFFSET) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,92 @@
+#include "geometry.h"
+
+#include <stdexcept>
+
+/*------------------------------------------------------------------*/
+// Constants
+/*------------------------------------------------------------------*/
+
+// largest grid whose index count, cells * cells * 6, fits the uint32_t
+// indexCount of vkCmdDrawIndexed. Its vertex indices then fit as well
+static const uint32_t MAX_GRID_CELLS = 26754;
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+VkVertexInputBindingDescription
+Vertex::bindingDescription() {
+    VkVertexInputBindingDescription description {};
+        description.binding = BINDING;
+        description.stride = sizeof(Vertex);
+        description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return description;
+}
+
+/*------------------------------------------------------------------*/
+
+std::array<VkVertexInputAttributeDescription, 2>
+Vertex::attributeDescriptions() {
+    return {
+        VERTEX_ATTRIBUTE(Vertex, position, 0, BINDING),
+        VERTEX_ATTRIBUTE(Vertex, color, 1, BINDING)
+    };
+}
+
+/*------------------------------------------------------------------*/
+
+Mesh
+makeTriangleMesh() {
+    Mesh mesh;
+
+    mesh.vertices = {
+        { {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+        { {  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f } },
+        { { -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } }
+    };
+    mesh.indices = { 0, 1, 2 };
+
+    return mesh;
+}
+
+/*------------------------------------------------------------------*/
+
+Mesh
+makeGridMesh(uint32_t cells) {
+    if(cells == 0 || cells > MAX_GRID_CELLS) {
+        throw std::runtime_error("grid mesh cells out of range!");
+    }
+
+    Mesh mesh;
+    uint32_t side = cells + 1;
+
+    // same extent as the triangle, colour follows the position
+    mesh.vertices.reserve(static_cast<size_t>(side) * side);
+    for(uint32_t y = 0; y < side; ++y) {
+        for(uint32_t x = 0; x < side; ++x) {
+            float u = static_cast<float>(x) / cells;
+            float v = static_cast<float>(y) / cells;
+
+            mesh.vertices.push_back({ { u - 0.5f, v - 0.5f },
+                                      { u, v, 1.0f - u } });
+        }
+    }
+
+    // two triangles per cell, same winding as the triangle
+    mesh.indices.reserve(static_cast<size_t>(cells) * cells * 6);
+    for(uint32_t y = 0; y < cells; ++y) {
+        for(uint32_t x = 0; x < cells; ++x) {
+            uint32_t topLeft = y * side + x;
+            uint32_t bottomLeft = topLeft + side;
+
+            mesh.indices.insert(mesh.indices.end(), {
+                                    topLeft, topLeft + 1, bottomLeft,
+                                    topLeft + 1, bottomLeft + 1, bottomLeft });
+        }
+    }
+
+    return mesh;
+}
+
+/*------------------------------------------------------------------*/
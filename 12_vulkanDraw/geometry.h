@@ -0,0 +1,79 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Vertex layout
+/*------------------------------------------------------------------*/
+
+// Pipeline vertex input is generated from the C++ vertex struct, so the
+// attribute formats and offsets cannot drift from the data uploaded.
+// VertexFormat maps a member type to its VkFormat, VERTEX_ATTRIBUTE builds
+// the attribute description of one member. Locations match the
+// layout(location = N) inputs of the vertex shaders.
+
+template<typename T> struct VertexFormat;
+
+template<> struct VertexFormat<float[2]> {
+    static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT;
+};
+template<> struct VertexFormat<float[3]> {
+    static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+template<> struct VertexFormat<float[4]> {
+    static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+
+#define VERTEX_ATTRIBUTE(type, member, location, binding)               \
+    VkVertexInputAttributeDescription {                                 \
+        (location), (binding),                                          \
+        VertexFormat<decltype(type::member)>::value,                    \
+        static_cast<uint32_t>(offsetof(type, member)) }
+
+struct Vertex {
+    float position[2];      // location 0, clip space
+    float color[3];         // location 1
+
+    static const uint32_t BINDING = 0;
+
+    static VkVertexInputBindingDescription bindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions();
+};
+
+/*------------------------------------------------------------------*/
+// Indexed meshes
+/*------------------------------------------------------------------*/
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;      // VK_INDEX_TYPE_UINT32
+
+    VkDeviceSize vertexBytes() const { return vertices.size() * sizeof(Vertex); }
+    VkDeviceSize indexBytes() const { return indices.size() * sizeof(uint32_t); }
+};
+
+Mesh makeTriangleMesh();                // the tutorial triangle
+Mesh makeGridMesh(uint32_t cells);      // cells x cells quads, upload benchmarks
+
+/*------------------------------------------------------------------*/
+// Per draw uniforms
+/*------------------------------------------------------------------*/
+
+// set 0, binding 0 of the vertex shaders, std140 layout. Written per frame
+// into the uniform ring and bound with a dynamic offset per draw
+
+struct DrawUniforms {
+    float transform[16];    // mat4, column major, clip space
+    float time;             // seconds since the first frame
+    float padding[3];       // std140 struct size is a multiple of 16
+};
+
+static_assert(sizeof(DrawUniforms) == 80, "DrawUniforms must match std140");
+
+/*------------------------------------------------------------------*/
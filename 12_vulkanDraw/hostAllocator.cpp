@@ -0,0 +1,398 @@
+#include "hostAllocator.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+/*------------------------------------------------------------------*/
+// Constants
+/*------------------------------------------------------------------*/
+
+// sits right before every pointer handed to the driver, the free callback
+// gets nothing but the pointer
+struct BlockHeader {
+    uint64_t size;              // requested
+    uint32_t offset;            // from the raw block to the pointer
+    uint8_t scope;
+    uint8_t sizeClass;
+    uint8_t origin;             // BlockOrigin
+    uint8_t reserved;
+};
+
+static_assert(sizeof(BlockHeader) == 16, "header must keep 16 byte alignment");
+
+enum BlockOrigin : uint8_t {
+    ORIGIN_POOL = 0,
+    ORIGIN_ARENA = 1,
+    ORIGIN_MALLOC = 2
+};
+
+static const size_t BASE_ALIGNMENT = sizeof(BlockHeader);
+
+static const char * SCOPE_NAMES[HostAllocator::SCOPE_COUNT] = {
+    "command", "object", "cache", "device", "instance"
+};
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static size_t
+alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/*------------------------------------------------------------------*/
+
+static BlockHeader *
+headerOf(void *memory) {
+    return reinterpret_cast<BlockHeader *>(static_cast<char *>(memory) -
+                                           sizeof(BlockHeader));
+}
+
+/*------------------------------------------------------------------*/
+
+// with a 16 byte aligned raw block, size + alignment bytes always hold the
+// header and the aligned payload
+static size_t
+blockBytes(size_t size, size_t alignment) {
+    return size + std::max(alignment, BASE_ALIGNMENT);
+}
+
+/*------------------------------------------------------------------*/
+
+static uint32_t
+sizeClassOf(size_t bytes) {
+    uint32_t sizeClass = 0;
+    while((HostAllocator::MIN_BLOCK << sizeClass) < bytes) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+/*------------------------------------------------------------------*/
+
+static uint32_t
+scopeIndex(VkSystemAllocationScope scope) {
+    uint32_t index = static_cast<uint32_t>(scope);
+    return index < HostAllocator::SCOPE_COUNT ? index :
+                   static_cast<uint32_t>(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+countAllocation(HostAllocator::ScopeStats &stats, uint64_t size) {
+    ++stats.allocations;
+    ++stats.liveCount;
+    stats.liveBytes += size;
+    stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+    stats.peakCount = std::max(stats.peakCount, stats.liveCount);
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+HostAllocator::HostAllocator() {
+    vkCallbacks.pUserData = this;
+    vkCallbacks.pfnAllocation = &HostAllocator::vkAllocate;
+    vkCallbacks.pfnReallocation = &HostAllocator::vkReallocate;
+    vkCallbacks.pfnFree = &HostAllocator::vkFree;
+    vkCallbacks.pfnInternalAllocation = &HostAllocator::vkInternalAllocate;
+    vkCallbacks.pfnInternalFree = &HostAllocator::vkInternalFree;
+
+    Scope &command = scopes[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND];
+    command.arena = static_cast<char *>(std::malloc(ARENA_SIZE));
+    if(command.arena != nullptr) {
+        command.stats.reservedBytes += ARENA_SIZE;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+HostAllocator::~HostAllocator() {
+    for(auto &scope : scopes) {
+        for(void *chunk : scope.chunks) {
+            std::free(chunk);
+        }
+        std::free(scope.arena);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+HostAllocator::ScopeStats
+HostAllocator::stats(VkSystemAllocationScope scope) const {
+    const Scope &entry = scopes[scopeIndex(scope)];
+
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    return entry.stats;
+}
+
+/*------------------------------------------------------------------*/
+
+uint64_t
+HostAllocator::allocationCount() const {
+    uint64_t count = 0;
+
+    for(const auto &scope : scopes) {
+        std::lock_guard<std::mutex> lock(scope.mutex);
+        count += scope.stats.allocations;
+    }
+
+    return count;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HostAllocator::print() const {
+    std::cout << INTENT_STR << "Host allocations by scope" << std::endl;
+
+    for(uint32_t i = 0; i < SCOPE_COUNT; ++i) {
+        ScopeStats entry = stats(static_cast<VkSystemAllocationScope>(i));
+
+        std::cout << INTENT_SPACE << INTENT_STR << std::left << std::setw(9)
+                  << SCOPE_NAMES[i] << std::right
+                  << " allocations: " << entry.allocations
+                  << " (pooled " << entry.pooled << ", arena " << entry.arena
+                  << ") frees: " << entry.frees
+                  << " live: " << entry.liveCount << " / " << entry.liveBytes
+                  << " B peak: " << entry.peakCount << " / " << entry.peakBytes
+                  << " B reserved: " << entry.reservedBytes << " B";
+
+        if(entry.internalPeak != 0) {
+            std::cout << " driver internal peak: " << entry.internalPeak << " B";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+void *
+HostAllocator::allocate(size_t size, size_t alignment,
+                        VkSystemAllocationScope scopeId) {
+    if(size == 0) {
+        return nullptr;
+    }
+
+    alignment = std::max(alignment, BASE_ALIGNMENT);
+    size_t bytes = blockBytes(size, alignment);
+
+    Scope &scope = scopes[scopeIndex(scopeId)];
+    std::lock_guard<std::mutex> lock(scope.mutex);
+
+    char *raw = nullptr;
+    uint8_t origin = ORIGIN_MALLOC;
+    uint32_t sizeClass = 0;
+
+    // command scope memory is gone before the call returns, bump allocate
+    // and rewind whenever nothing is outstanding
+    if(scope.arena != nullptr && scope.arenaOffset + bytes <= ARENA_SIZE) {
+        raw = scope.arena + scope.arenaOffset;
+        scope.arenaOffset += alignUp(bytes, BASE_ALIGNMENT);
+        ++scope.arenaLive;
+        ++scope.stats.arena;
+        origin = ORIGIN_ARENA;
+    }
+    else if(bytes <= MAX_BLOCK) {
+        sizeClass = sizeClassOf(bytes);
+        raw = static_cast<char *>(allocateBlock(scope, sizeClass));
+        ++scope.stats.pooled;
+        origin = ORIGIN_POOL;
+    }
+    else {
+        raw = static_cast<char *>(std::malloc(bytes));
+    }
+
+    if(raw == nullptr) {
+        return nullptr;
+    }
+
+    char *memory = reinterpret_cast<char *>(
+                        alignUp(reinterpret_cast<uintptr_t>(raw) + sizeof(BlockHeader),
+                                alignment));
+
+    BlockHeader *header = headerOf(memory);
+        header->size = size;
+        header->offset = static_cast<uint32_t>(memory - raw);
+        header->scope = static_cast<uint8_t>(scopeIndex(scopeId));
+        header->sizeClass = static_cast<uint8_t>(sizeClass);
+        header->origin = origin;
+        header->reserved = 0;
+
+    countAllocation(scope.stats, size);
+
+    return memory;
+}
+
+/*------------------------------------------------------------------*/
+
+void *
+HostAllocator::reallocate(void *original, size_t size, size_t alignment,
+                          VkSystemAllocationScope scopeId) {
+    if(original == nullptr) {
+        return allocate(size, alignment, scopeId);
+    }
+
+    if(size == 0) {
+        release(original);
+        return nullptr;
+    }
+
+    BlockHeader *header = headerOf(original);
+
+    // grow or shrink inside the pool block when it still fits behind the
+    // original's alignment padding
+    if(header->origin == ORIGIN_POOL &&
+       header->offset + size <= (MIN_BLOCK << header->sizeClass)) {
+        Scope &scope = scopes[header->scope];
+        std::lock_guard<std::mutex> lock(scope.mutex);
+
+        scope.stats.liveBytes = scope.stats.liveBytes - header->size + size;
+        scope.stats.peakBytes = std::max(scope.stats.peakBytes, scope.stats.liveBytes);
+        ++scope.stats.allocations;
+        header->size = size;
+
+        return original;
+    }
+
+    // the original stays valid if this fails
+    void *memory = allocate(size, alignment, scopeId);
+
+    if(memory != nullptr) {
+        std::memcpy(memory, original, std::min<size_t>(size, header->size));
+        release(original);
+    }
+
+    return memory;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HostAllocator::release(void *memory) {
+    if(memory == nullptr) {
+        return;
+    }
+
+    BlockHeader *header = headerOf(memory);
+    char *raw = static_cast<char *>(memory) - header->offset;
+
+    Scope &scope = scopes[header->scope];
+    std::lock_guard<std::mutex> lock(scope.mutex);
+
+    ++scope.stats.frees;
+    --scope.stats.liveCount;
+    scope.stats.liveBytes -= header->size;
+
+    switch(header->origin) {
+        case ORIGIN_POOL: {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(raw);
+            block->next = scope.freeLists[header->sizeClass];
+            scope.freeLists[header->sizeClass] = block;
+            break;
+        }
+        case ORIGIN_ARENA:
+            if(--scope.arenaLive == 0) {
+                scope.arenaOffset = 0;
+            }
+            break;
+        default:
+            std::free(raw);
+            break;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+// caller holds scope.mutex
+void *
+HostAllocator::allocateBlock(Scope &scope, uint32_t sizeClass) {
+    if(scope.freeLists[sizeClass] == nullptr) {
+        // carve a new chunk into blocks of this class. malloc returns 16
+        // byte aligned memory and every class is a multiple of that
+        char *chunk = static_cast<char *>(std::malloc(CHUNK_SIZE));
+        if(chunk == nullptr) {
+            return nullptr;
+        }
+
+        scope.chunks.push_back(chunk);
+        scope.stats.reservedBytes += CHUNK_SIZE;
+
+        size_t blockSize = MIN_BLOCK << sizeClass;
+        for(size_t offset = CHUNK_SIZE; offset >= blockSize; offset -= blockSize) {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + offset - blockSize);
+            block->next = scope.freeLists[sizeClass];
+            scope.freeLists[sizeClass] = block;
+        }
+    }
+
+    FreeBlock *block = scope.freeLists[sizeClass];
+    scope.freeLists[sizeClass] = block->next;
+
+    return block;
+}
+
+/*------------------------------------------------------------------*/
+
+VKAPI_ATTR void * VKAPI_CALL
+HostAllocator::vkAllocate(void *userData, size_t size, size_t alignment,
+                          VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator *>(userData)->allocate(size, alignment, scope);
+}
+
+/*------------------------------------------------------------------*/
+
+VKAPI_ATTR void * VKAPI_CALL
+HostAllocator::vkReallocate(void *userData, void *original, size_t size,
+                            size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator *>(userData)->reallocate(original, size,
+                                                              alignment, scope);
+}
+
+/*------------------------------------------------------------------*/
+
+VKAPI_ATTR void VKAPI_CALL
+HostAllocator::vkFree(void *userData, void *memory) {
+    static_cast<HostAllocator *>(userData)->release(memory);
+}
+
+/*------------------------------------------------------------------*/
+
+VKAPI_ATTR void VKAPI_CALL
+HostAllocator::vkInternalAllocate(void *userData, size_t size,
+                                  VkInternalAllocationType /*type*/,
+                                  VkSystemAllocationScope scopeId) {
+    HostAllocator *allocator = static_cast<HostAllocator *>(userData);
+    Scope &scope = allocator->scopes[scopeIndex(scopeId)];
+
+    std::lock_guard<std::mutex> lock(scope.mutex);
+    scope.stats.internalBytes += size;
+    scope.stats.internalPeak = std::max(scope.stats.internalPeak,
+                                        scope.stats.internalBytes);
+}
+
+/*------------------------------------------------------------------*/
+
+VKAPI_ATTR void VKAPI_CALL
+HostAllocator::vkInternalFree(void *userData, size_t size,
+                              VkInternalAllocationType /*type*/,
+                              VkSystemAllocationScope scopeId) {
+    HostAllocator *allocator = static_cast<HostAllocator *>(userData);
+    Scope &scope = allocator->scopes[scopeIndex(scopeId)];
+
+    std::lock_guard<std::mutex> lock(scope.mutex);
+    scope.stats.internalBytes -= std::min<uint64_t>(size, scope.stats.internalBytes);
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,101 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*------------------------------------------------------------------*/
+// Instrumented host allocator for VkAllocationCallbacks
+/*------------------------------------------------------------------*/
+
+// Serves the driver's host allocations from per scope size class pools, so
+// long lived objects, caches and per command scratch do not fragment each
+// other. Command scope allocations live only for the duration of one
+// vulkan call and go to a bump arena that rewinds once they are all freed.
+// Requests larger than the biggest size class go to malloc. Live counters,
+// high water marks and totals are kept per scope; allocationCount() taken
+// around the frame loop shows drivers that allocate every frame.
+// Must outlive every object created with callbacks(). Thread safe.
+
+class HostAllocator {
+
+    public:
+        static const uint32_t SCOPE_COUNT = 5;      // command .. instance
+        static const uint32_t CLASS_COUNT = 8;      // 32 .. 4096 byte blocks
+        static const size_t MIN_BLOCK = 32;
+        static const size_t MAX_BLOCK = MIN_BLOCK << (CLASS_COUNT - 1);
+        static const size_t CHUNK_SIZE = 64 * 1024;         // pool growth
+        static const size_t ARENA_SIZE = 256 * 1024;        // command scope
+
+        struct ScopeStats {
+            uint64_t liveBytes = 0;         // requested sizes
+            uint64_t liveCount = 0;
+            uint64_t peakBytes = 0;
+            uint64_t peakCount = 0;
+            uint64_t allocations = 0;       // including reallocations
+            uint64_t frees = 0;
+            uint64_t pooled = 0;            // allocations served by the pools
+            uint64_t arena = 0;             // by the command arena
+            uint64_t reservedBytes = 0;     // pool chunks held
+            uint64_t internalBytes = 0;     // driver's own, reported only
+            uint64_t internalPeak = 0;
+        };
+
+        HostAllocator();
+        ~HostAllocator();
+
+        HostAllocator(const HostAllocator &) = delete;
+        HostAllocator & operator=(const HostAllocator &) = delete;
+
+        const VkAllocationCallbacks * callbacks() const { return &vkCallbacks; }
+
+        ScopeStats stats(VkSystemAllocationScope scope) const;
+        uint64_t allocationCount() const;   // all scopes, monotonic
+        void print() const;
+
+    private:
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        struct Scope {
+            mutable std::mutex mutex;
+            FreeBlock *freeLists[CLASS_COUNT] = {};
+            std::vector<void *> chunks;
+            char *arena = nullptr;          // command scope only
+            size_t arenaOffset = 0;
+            uint64_t arenaLive = 0;
+            ScopeStats stats;
+        };
+
+        void * allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+        void * reallocate(void *original, size_t size, size_t alignment,
+                          VkSystemAllocationScope scope);
+        void release(void *memory);
+
+        void * allocateBlock(Scope &scope, uint32_t sizeClass);
+
+        static VKAPI_ATTR void * VKAPI_CALL vkAllocate(void *userData,
+                                    size_t size, size_t alignment,
+                                    VkSystemAllocationScope scope);
+        static VKAPI_ATTR void * VKAPI_CALL vkReallocate(void *userData,
+                                    void *original, size_t size, size_t alignment,
+                                    VkSystemAllocationScope scope);
+        static VKAPI_ATTR void VKAPI_CALL vkFree(void *userData, void *memory);
+        static VKAPI_ATTR void VKAPI_CALL vkInternalAllocate(void *userData,
+                                    size_t size, VkInternalAllocationType type,
+                                    VkSystemAllocationScope scope);
+        static VKAPI_ATTR void VKAPI_CALL vkInternalFree(void *userData,
+                                    size_t size, VkInternalAllocationType type,
+                                    VkSystemAllocationScope scope);
+
+    private:
+        VkAllocationCallbacks vkCallbacks {};
+        Scope scopes[SCOPE_COUNT];
+};
+
+/*------------------------------------------------------------------*/
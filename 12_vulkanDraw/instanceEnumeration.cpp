@@ -0,0 +1,317 @@
+#include "instanceEnumeration.h"
+#include "fileView.h"
+#include "fnv1a.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+/*------------------------------------------------------------------*/
+// Constants
+/*------------------------------------------------------------------*/
+
+// cache file layout: this header followed by extensionCount
+// VkExtensionProperties and layerCount VkLayerProperties
+struct InstanceCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;               // see enumerationKey()
+    uint32_t extensionCount;
+    uint32_t layerCount;
+};
+
+static const uint32_t INSTANCE_CACHE_MAGIC = 0x45494456;   // "VDIE"
+static const uint32_t INSTANCE_CACHE_FILE_VERSION = 1;
+
+// manifest directories below each search root, see the loader's
+// LoaderInterfaceArchitecture document
+static const char * MANIFEST_DIRS[] = {
+    "/vulkan/icd.d",
+    "/vulkan/implicit_layer.d",
+    "/vulkan/explicit_layer.d"
+};
+
+// environment that changes what the loader finds or enables
+static const char * LOADER_ENV[] = {
+    "VK_ICD_FILENAMES", "VK_DRIVER_FILES", "VK_ADD_DRIVER_FILES",
+    "VK_LAYER_PATH", "VK_ADD_LAYER_PATH", "VK_INSTANCE_LAYERS",
+    "VK_LOADER_LAYERS_ENABLE", "VK_LOADER_LAYERS_DISABLE",
+    "VK_LOADER_DRIVERS_SELECT", "VK_LOADER_DRIVERS_DISABLE"
+};
+
+// environment variables holding colon separated manifest files or dirs
+static const char * LOADER_PATH_ENV[] = {
+    "VK_ICD_FILENAMES", "VK_DRIVER_FILES", "VK_ADD_DRIVER_FILES",
+    "VK_LAYER_PATH", "VK_ADD_LAYER_PATH"
+};
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static std::vector<std::string>
+splitPaths(const std::string &list) {
+    std::vector<std::string> paths;
+    size_t start = 0;
+
+    while(start <= list.size()) {
+        size_t end = list.find(':', start);
+        if(end == std::string::npos) {
+            end = list.size();
+        }
+        if(end > start) {
+            paths.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+
+    return paths;
+}
+
+/*------------------------------------------------------------------*/
+
+static std::string
+envOr(const char *name, const std::string &fallback) {
+    const char *value = std::getenv(name);
+    return (value != nullptr && *value != '\0') ? value : fallback;
+}
+
+/*------------------------------------------------------------------*/
+
+// mixes path, size and mtime of path into hash. A directory also mixes in
+// all of its entries, sorted so readdir order does not matter. Missing
+// paths still change the hash by their name
+static uint64_t
+hashPath(const std::string &path, uint64_t hash) {
+    hash = fnv1aHash(path.data(), path.size(), hash);
+
+    struct stat pathStat;
+    if(::stat(path.c_str(), &pathStat) != 0) {
+        return hash;
+    }
+
+    hash = fnv1aHash(&pathStat.st_size, sizeof(pathStat.st_size), hash);
+    hash = fnv1aHash(&pathStat.st_mtim, sizeof(pathStat.st_mtim), hash);
+
+    if(!S_ISDIR(pathStat.st_mode)) {
+        return hash;
+    }
+
+    std::vector<std::string> entries;
+
+    if(DIR *dir = ::opendir(path.c_str())) {
+        while(struct dirent *entry = ::readdir(dir)) {
+            if(entry->d_name[0] != '.') {
+                entries.emplace_back(entry->d_name);
+            }
+        }
+        ::closedir(dir);
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    for(const auto &entry : entries) {
+        hash = hashPath(path + "/" + entry, hash);
+    }
+
+    return hash;
+}
+
+/*------------------------------------------------------------------*/
+
+// everything the loader's enumeration result depends on
+static uint64_t
+enumerationKey() {
+    uint64_t hash = FNV1A_OFFSET;
+
+    // the loader library itself, a loader update can change the results
+    Dl_info info;
+    if(::dladdr(reinterpret_cast<void *>(&vkEnumerateInstanceExtensionProperties),
+                &info) != 0 && info.dli_fname != nullptr) {
+        hash = hashPath(info.dli_fname, hash);
+    }
+
+    // manifest search roots, per user then system wide
+    std::string home = envOr("HOME", "");
+    std::vector<std::string> roots;
+
+    roots.push_back(envOr("XDG_CONFIG_HOME", home + "/.config"));
+    for(const auto &dir : splitPaths(envOr("XDG_CONFIG_DIRS", "/etc/xdg"))) {
+        roots.push_back(dir);
+    }
+    roots.push_back("/etc");
+    roots.push_back(envOr("XDG_DATA_HOME", home + "/.local/share"));
+    for(const auto &dir : splitPaths(envOr("XDG_DATA_DIRS",
+                                           "/usr/local/share:/usr/share"))) {
+        roots.push_back(dir);
+    }
+
+    for(const auto &root : roots) {
+        for(const char *dir : MANIFEST_DIRS) {
+            hash = hashPath(root + dir, hash);
+        }
+    }
+
+    for(const char *name : LOADER_ENV) {
+        std::string value = envOr(name, "");
+        hash = fnv1aHash(name, std::strlen(name), hash);
+        hash = fnv1aHash(value.data(), value.size(), hash);
+    }
+
+    for(const char *name : LOADER_PATH_ENV) {
+        for(const auto &path : splitPaths(envOr(name, ""))) {
+            hash = hashPath(path, hash);
+        }
+    }
+
+    return hash;
+}
+
+/*------------------------------------------------------------------*/
+
+static bool
+loadCache(const std::string &path, uint64_t key, InstanceEnumeration &result) {
+    FileView file;
+
+    if(!file.map(path) || file.size() < sizeof(InstanceCacheHeader)) {
+        return false;
+    }
+
+    InstanceCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    size_t extensionBytes = header.extensionCount * sizeof(VkExtensionProperties);
+    size_t layerBytes = header.layerCount * sizeof(VkLayerProperties);
+
+    if(header.magic != INSTANCE_CACHE_MAGIC ||
+       header.version != INSTANCE_CACHE_FILE_VERSION ||
+       header.key != key ||
+       file.size() != sizeof(header) + extensionBytes + layerBytes) {
+        return false;
+    }
+
+    const char *data = file.as<char>() + sizeof(header);
+
+    result.extensions.resize(header.extensionCount);
+    std::memcpy(result.extensions.data(), data, extensionBytes);
+
+    result.layers.resize(header.layerCount);
+    std::memcpy(result.layers.data(), data + extensionBytes, layerBytes);
+
+    return true;
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+saveCache(const std::string &path, uint64_t key,
+          const InstanceEnumeration &result) {
+    InstanceCacheHeader header {};
+        header.magic = INSTANCE_CACHE_MAGIC;
+        header.version = INSTANCE_CACHE_FILE_VERSION;
+        header.key = key;
+        header.extensionCount = static_cast<uint32_t>(result.extensions.size());
+        header.layerCount = static_cast<uint32_t>(result.layers.size());
+
+    // write aside and rename, like the pipeline cache
+    std::string tmpPath = path + ".tmp";
+
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(result.extensions.data()),
+                   result.extensions.size() * sizeof(VkExtensionProperties));
+        file.write(reinterpret_cast<const char *>(result.layers.data()),
+                   result.layers.size() * sizeof(VkLayerProperties));
+
+        if(!file) {
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+    }
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+InstanceEnumeration
+InstanceEnumeration::query(const std::string &cachePath) {
+    InstanceEnumeration result;
+    uint64_t key = 0;
+
+    if(!cachePath.empty()) {
+        key = enumerationKey();
+
+        if(loadCache(cachePath, key, result)) {
+            result.fromCache = true;
+            return result;
+        }
+    }
+
+    uint32_t extCnt = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extCnt, nullptr);
+
+    result.extensions.resize(extCnt);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extCnt,
+                                           result.extensions.data());
+    result.extensions.resize(extCnt);
+
+    uint32_t layerCnt = 0;
+    vkEnumerateInstanceLayerProperties(&layerCnt, nullptr);
+
+    result.layers.resize(layerCnt);
+    vkEnumerateInstanceLayerProperties(&layerCnt, result.layers.data());
+    result.layers.resize(layerCnt);
+
+    std::sort(result.extensions.begin(), result.extensions.end(),
+              [](const VkExtensionProperties &lhs, const VkExtensionProperties &rhs) {
+                  return std::strcmp(lhs.extensionName, rhs.extensionName) < 0;
+              });
+    std::sort(result.layers.begin(), result.layers.end(),
+              [](const VkLayerProperties &lhs, const VkLayerProperties &rhs) {
+                  return std::strcmp(lhs.layerName, rhs.layerName) < 0;
+              });
+
+    if(!cachePath.empty()) {
+        saveCache(cachePath, key, result);
+    }
+
+    return result;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+InstanceEnumeration::hasExtension(const char *name) const {
+    auto it = std::lower_bound(extensions.begin(), extensions.end(), name,
+                               [](const VkExtensionProperties &e, const char *n) {
+                                   return std::strcmp(e.extensionName, n) < 0;
+                               });
+
+    return it != extensions.end() && std::strcmp(it->extensionName, name) == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+InstanceEnumeration::hasLayer(const char *name) const {
+    auto it = std::lower_bound(layers.begin(), layers.end(), name,
+                               [](const VkLayerProperties &l, const char *n) {
+                                   return std::strcmp(l.layerName, n) < 0;
+                               });
+
+    return it != layers.end() && std::strcmp(it->layerName, name) == 0;
+}
+
+/*------------------------------------------------------------------*/
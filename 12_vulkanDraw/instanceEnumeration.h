@@ -0,0 +1,34 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Instance extension and layer enumeration
+/*------------------------------------------------------------------*/
+
+// Instance extensions and layers the loader reports, sorted by name so
+// lookups are a binary search without building strings. Enumerating makes
+// the loader read every icd and layer manifest; with a cache path the
+// result is saved and reused until the loader library, a manifest or one
+// of the loader environment variables changes (keyed by path, size and
+// mtime, no manifest is parsed to check).
+
+struct InstanceEnumeration {
+    std::vector<VkExtensionProperties> extensions;
+    std::vector<VkLayerProperties> layers;
+    bool fromCache = false;         // loaded from the cache file
+
+    // empty cachePath always enumerates. A missing, stale or unreadable
+    // cache is rebuilt, failing to write it is not an error
+    static InstanceEnumeration query(const std::string &cachePath);
+
+    bool hasExtension(const char *name) const;
+    bool hasLayer(const char *name) const;
+};
+
+/*------------------------------------------------------------------*/
@@ -3,15 +3,311 @@
 #include <iostream>     // console reporting
 #include <stdexcept>    // error handling
 #include <cstdlib>      // EXIT macro definitions
+#include <cstring>      // argument comparison
+#include <string>       // argument conversion
+#include <cstdint>      // capture checksum
+
+/*------------------------------------------------------------------*/
+
+static void
+printUsage(const char *program) {
+    std::cout << "usage: " << program << " [options]" << std::endl
+              << "\t--frames-in-flight N   frames recorded ahead of the gpu"
+              << " (default 2)" << std::endl
+              << "\t--frames N             exit after N frames (default: run"
+              << " until the window is closed)" << std::endl
+              << "\t--prerecord            record per swapchain image command"
+              << " buffers once, re-record only when dirty" << std::endl
+              << "\t--resize-stress N      resize the window N times and report"
+              << " the swapchain recreation stall" << std::endl
+              << "\t--present-mode POLICY  latency, power, tearfree (default)"
+              << " or immediate; 'P' cycles at runtime" << std::endl
+              << "\t--no-timeline          sync frames with fences even if"
+              << " timeline semaphores are supported" << std::endl
+              << "\t--render-thread        render on a dedicated thread,"
+              << " decoupled from glfw event polling" << std::endl
+              << "\t--record-threads N     record secondary command buffers on"
+              << " N threads (default 0, inline)" << std::endl
+              << "\t--draws N              draws per frame (default 1)" << std::endl
+              << "\t--fps N                cap the frame rate at N (default"
+              << " uncapped)" << std::endl
+              << "\t--on-demand            render only when the window contents"
+              << " are stale, idle otherwise" << std::endl
+              << "\t--headless             render offscreen without a window,"
+              << " requires --frames" << std::endl
+              << "\t--extent WxH           window or offscreen size (default"
+              << " 800x600)" << std::endl
+              << "\t--capture              read every frame back to the cpu,"
+              << " prints a checksum of the last one" << std::endl
+              << "\t--pipeline-cache FILE  on-disk pipeline cache (default"
+              << " pipeline_cache.bin)" << std::endl
+              << "\t--no-pipeline-cache    compile pipelines from scratch"
+              << std::endl
+              << "\t--shader-dir DIR       load vert.spv/frag.spv from DIR"
+              << " instead of the embedded shaders" << std::endl
+              << "\t--shader-source DIR    compile the glsl sources in DIR at"
+              << " startup instead of the embedded shaders" << std::endl
+              << "\t--shader-cache DIR     compiled spir-v cache (default"
+              << " shader_cache)" << std::endl
+              << "\t--no-shader-cache      compile glsl sources every time"
+              << std::endl
+              << "\t--hot-reload DIR       recompile glsl sources in DIR when"
+              << " they change and swap the pipelines live" << std::endl
+              << "\t--pipeline-variants N  pipeline variants built at startup"
+              << " (default 2); 'V' cycles at runtime" << std::endl
+              << "\t--build-threads N      pipeline build threads (default:"
+              << " one per core)" << std::endl
+              << "\t--instance-cache FILE  reuse the instance extension and"
+              << " layer enumeration until the loader setup changes" << std::endl
+              << "\t--memory-block MIB     device memory block size for buffers"
+              << " and images (default 64)" << std::endl
+              << "\t--mesh-cells N         upload an N x N grid mesh while the"
+              << " triangle is drawn, then draw it" << std::endl
+              << "\t--no-transfer-queue    upload on the graphics queue even"
+              << " with a transfer queue family" << std::endl
+              << "\t--host-allocator       route driver host allocations through"
+              << " the pooled allocator and report them" << std::endl
+              << "\t--calibrate-devices    benchmark every suitable device and"
+              << " add the result to its score" << std::endl
+              << "\t--startup-report FILE  write the startup phase timings"
+              << " to FILE as json" << std::endl
+              << "\t--startup-history FILE append the timings to FILE and"
+              << " print the summary across runs" << std::endl
+              << "environment:" << std::endl
+              << "\tVULKAN_DRAW_DEVICE=N|NAME  use device N of the candidate"
+              << " list, or the first whose name contains NAME" << std::endl;
+}
+
+/*------------------------------------------------------------------*/
+
+static PresentPolicy
+parsePresentPolicy(const char *name) {
+    const PresentPolicy policies[] = { PresentPolicy::LowLatency,
+                                       PresentPolicy::LowPower,
+                                       PresentPolicy::TearFree,
+                                       PresentPolicy::Immediate };
+
+    for(auto policy : policies) {
+        if(std::strcmp(name, presentPolicyName(policy)) == 0) {
+            return policy;
+        }
+    }
+
+    throw std::invalid_argument(std::string("unknown present mode policy ") + name);
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+parseExtent(const char *value, AppConfig &config) {
+    std::string extent(value);
+    size_t separator = extent.find('x');
+
+    if(separator == std::string::npos) {
+        throw std::invalid_argument("extent must be WxH, got " + extent);
+    }
+
+    config.width = static_cast<uint32_t>(std::stoul(extent.substr(0, separator)));
+    config.height = static_cast<uint32_t>(std::stoul(extent.substr(separator + 1)));
+
+    if(config.width == 0 || config.height == 0) {
+        throw std::invalid_argument("extent must not be empty");
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+static AppConfig
+parseArgs(int argc, char *argv[]) {
+    AppConfig config;
+
+    for(int i = 1; i < argc; ++i) {
+        // flags without value
+        if(std::strcmp(argv[i], "--prerecord") == 0) {
+            config.prerecord = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--no-timeline") == 0) {
+            config.timelineSemaphores = false;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--render-thread") == 0) {
+            config.renderThread = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--on-demand") == 0) {
+            config.onDemand = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--headless") == 0) {
+            config.headless = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--capture") == 0) {
+            config.capture = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--calibrate-devices") == 0) {
+            config.calibrateDevices = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--host-allocator") == 0) {
+            config.hostAllocator = true;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--no-transfer-queue") == 0) {
+            config.transferQueue = false;
+            continue;
+        }
+        if(std::strcmp(argv[i], "--no-pipeline-cache") == 0) {
+            config.pipelineCachePath.clear();
+            continue;
+        }
+        if(std::strcmp(argv[i], "--no-shader-cache") == 0) {
+            config.shaderCacheDir.clear();
+            continue;
+        }
+
+        // remaining options take one value
+        if(i + 1 >= argc) {
+            throw std::invalid_argument(std::string("missing value for ") + argv[i]);
+        }
+
+        if(std::strcmp(argv[i], "--frames-in-flight") == 0) {
+            config.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--frames") == 0) {
+            config.maxFrames = std::stoull(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--present-mode") == 0) {
+            config.presentPolicy = parsePresentPolicy(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--record-threads") == 0) {
+            config.recordThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--draws") == 0) {
+            config.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--extent") == 0) {
+            parseExtent(argv[++i], config);
+        }
+        else if(std::strcmp(argv[i], "--pipeline-variants") == 0) {
+            config.pipelineVariants = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--memory-block") == 0) {
+            config.memoryBlockMiB = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--mesh-cells") == 0) {
+            config.meshCells = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--build-threads") == 0) {
+            config.buildThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--hot-reload") == 0) {
+            config.hotReloadDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--shader-source") == 0) {
+            config.shaderSourceDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--shader-cache") == 0) {
+            config.shaderCacheDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--shader-dir") == 0) {
+            config.shaderDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--pipeline-cache") == 0) {
+            config.pipelineCachePath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--instance-cache") == 0) {
+            config.instanceCachePath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--startup-report") == 0) {
+            config.startupReportPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--startup-history") == 0) {
+            config.startupHistoryPath = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--fps") == 0) {
+            config.targetFps = std::stod(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--resize-stress") == 0) {
+            config.resizeStress = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else {
+            throw std::invalid_argument(std::string("unknown option ") + argv[i]);
+        }
+    }
+
+    // start from the sources being watched, not the embedded build of them
+    if(!config.hotReloadDir.empty() && config.shaderSourceDir.empty()) {
+        config.shaderSourceDir = config.hotReloadDir;
+    }
+
+    // pre-recorded buffers are per image, the readback ring per frame slot
+    if(config.capture && config.prerecord) {
+        throw std::invalid_argument("--capture records per frame, it cannot be"
+                                    " combined with --prerecord");
+    }
+
+    // headless has no window events to wait for or resize, and no close
+    // button to end the run
+    if(config.headless) {
+        if(config.maxFrames == 0) {
+            throw std::invalid_argument("--headless requires --frames");
+        }
+        if(config.renderThread || config.onDemand || config.resizeStress != 0) {
+            throw std::invalid_argument("--render-thread, --on-demand and"
+                                        " --resize-stress need a window");
+        }
+    }
+
+    return config;
+}
 
 /*------------------------------------------------------------------*/
 
 int
-main() {
-    HelloTriangleApplication app;
+main(int argc, char *argv[]) {
+    AppConfig config;
 
     try {
+        config = parseArgs(argc, argv);
+    } catch(const std::exception & e) {
+        std::cout << e.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        HelloTriangleApplication app(config);
+
+        // sample consumer: checksum of the latest frame, read in place from
+        // the staging buffer
+        uint64_t captureChecksum = 0;
+        uint64_t captureFrame = 0;
+
+        if(config.capture) {
+            app.setCaptureCallback([&](const CapturedFrame &frame) {
+                const uint32_t *pixels = static_cast<const uint32_t *>(frame.pixels);
+                size_t pixelCount = static_cast<size_t>(frame.rowPitch / 4) *
+                                    frame.extent.height;
+
+                uint64_t checksum = 0;
+                for(size_t i = 0; i < pixelCount; ++i) {
+                    checksum = checksum * 31 + pixels[i];
+                }
+
+                captureChecksum = checksum;
+                captureFrame = frame.frame;
+            });
+        }
+
         app.run();
+
+        if(config.capture) {
+            std::cout << "capture checksum of frame " << captureFrame << ": "
+                      << std::hex << captureChecksum << std::dec << std::endl;
+        }
     } catch(const std::exception & e) {
         std::cout << e.what() << std::endl;
         return EXIT_FAILURE;
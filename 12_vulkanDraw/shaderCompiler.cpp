@@ -0,0 +1,411 @@
+#include "shaderCompiler.h"
+#include "fileView.h"
+#include "fnv1a.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_SHADERC
+    #include <shaderc/shaderc.h>
+    #include <dlfcn.h>
+#endif
+
+/*------------------------------------------------------------------*/
+// Constants
+/*------------------------------------------------------------------*/
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// unique temporary file names across threads of this process
+static std::atomic<uint64_t> tmpCounter {0};
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static const char *
+stageName(ShaderCompiler::Stage stage) {
+    switch(stage) {
+        case ShaderCompiler::Stage::Vertex:     return "vert";
+        case ShaderCompiler::Stage::Fragment:   return "frag";
+        case ShaderCompiler::Stage::Compute:    return "comp";
+    }
+    return "";
+}
+
+/*------------------------------------------------------------------*/
+
+static std::string
+tmpSuffix() {
+    return std::to_string(::getpid()) + "_" + std::to_string(tmpCounter++);
+}
+
+/*------------------------------------------------------------------*/
+
+static std::string
+readTextFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+
+    if(!file.is_open()) {
+        throw std::runtime_error("failed to open " + path);
+    }
+
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+/*------------------------------------------------------------------*/
+
+// cached spir-v, empty if missing or not spir-v
+static std::vector<uint32_t>
+loadSpirv(const std::string &path) {
+    FileView file;
+
+    if(!file.map(path) || file.empty() || file.size() % sizeof(uint32_t) != 0 ||
+       file.as<uint32_t>()[0] != SPIRV_MAGIC) {
+        return {};
+    }
+
+    return std::vector<uint32_t>(file.as<uint32_t>(),
+                                 file.as<uint32_t>() + file.size() / sizeof(uint32_t));
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+storeSpirv(const std::string &path, const std::vector<uint32_t> &code) {
+    // write aside and rename, concurrent builds may fill the same entry
+    std::string tmpPath = path + ".tmp" + tmpSuffix();
+
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(code.data()),
+                   code.size() * sizeof(uint32_t));
+
+        if(!file) {
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+#ifdef HAVE_SHADERC
+
+// shaderc has no version query, the library file it was loaded from stands
+// in for it: path, size and mtime change with any update. Statically linked
+// that is the executable itself
+static std::string
+shadercStamp() {
+    Dl_info info;
+    struct stat libStat;
+
+    if(::dladdr(reinterpret_cast<void *>(&shaderc_compiler_initialize),
+                &info) == 0 || info.dli_fname == nullptr ||
+       ::stat(info.dli_fname, &libStat) != 0) {
+        throw std::runtime_error("failed to locate the shaderc library");
+    }
+
+    return std::string(info.dli_fname) + " " + std::to_string(libStat.st_size) +
+           " " + std::to_string(libStat.st_mtim.tv_sec) + "." +
+           std::to_string(libStat.st_mtim.tv_nsec);
+}
+
+#else
+
+static std::string
+glslcPath() {
+    const char *glslc = std::getenv("GLSLC");
+    return (glslc != nullptr && *glslc != '\0') ? glslc : "/usr/local/bin/glslc";
+}
+
+/*------------------------------------------------------------------*/
+
+static int
+runGlslc(const std::vector<std::string> &args, std::string *output,
+         bool withErrors = false) {
+    // no shell in between, paths and define values reach glslc verbatim.
+    // output != nullptr captures stdout, and stderr with withErrors, else
+    // stderr is dropped. Returns the exit status, -1 when glslc could not
+    // be run
+    std::string path = glslcPath();
+
+    // built before fork, the child only execs
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(path.c_str()));
+    for(const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    // close on exec, so concurrent compiles do not inherit each other's pipe
+    int fds[2] = { -1, -1 };
+    if(output != nullptr && ::pipe2(fds, O_CLOEXEC) != 0) {
+        return -1;
+    }
+
+    pid_t pid = ::fork();
+
+    if(pid == 0) {
+        if(output != nullptr) {
+            ::dup2(fds[1], STDOUT_FILENO);
+
+            int errors = withErrors ? fds[1] : ::open("/dev/null", O_WRONLY);
+            if(errors >= 0) {
+                ::dup2(errors, STDERR_FILENO);
+            }
+        }
+        ::execvp(argv[0], argv.data());
+        ::_exit(127);
+    }
+
+    if(output != nullptr) {
+        ::close(fds[1]);
+
+        char buffer[256];
+        ssize_t count;
+        while(pid > 0 && ((count = ::read(fds[0], buffer, sizeof(buffer))) > 0 ||
+                          (count < 0 && errno == EINTR))) {
+            if(count > 0) {
+                output->append(buffer, static_cast<size_t>(count));
+            }
+        }
+
+        ::close(fds[0]);
+    }
+
+    if(pid < 0) {
+        return -1;
+    }
+
+    int status = 0;
+    while(::waitpid(pid, &status, 0) < 0) {
+        if(errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+#endif
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+ShaderCompiler::ShaderCompiler(const std::string &cacheDir)
+    : cacheDir(cacheDir) {
+#ifdef HAVE_SHADERC
+    shaderc = shaderc_compiler_initialize();
+
+    if(shaderc == nullptr) {
+        throw std::runtime_error("failed to initialize shaderc");
+    }
+
+    unsigned int version = 0;
+    unsigned int revision = 0;
+    shaderc_get_spv_version(&version, &revision);
+
+    compilerVersion = "shaderc " + shadercStamp() + " spv " +
+                      std::to_string(version) + "." + std::to_string(revision);
+#else
+    // the full version banner names the shaderc, glslang and spirv-tools
+    // revisions, any update invalidates the cache
+    if(runGlslc({ "--version" }, &compilerVersion) != 0 ||
+       compilerVersion.empty()) {
+        throw std::runtime_error("no shader compiler: " + glslcPath() +
+                                 " not found, set GLSLC or build with shaderc");
+    }
+#endif
+
+    if(!cacheDir.empty()) {
+        ::mkdir(cacheDir.c_str(), 0755);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+ShaderCompiler::~ShaderCompiler() {
+#ifdef HAVE_SHADERC
+    shaderc_compiler_release(static_cast<shaderc_compiler_t>(shaderc));
+#endif
+}
+
+/*------------------------------------------------------------------*/
+
+std::vector<uint32_t>
+ShaderCompiler::compile(const std::string &source, Stage stage,
+                        const std::string &name,
+                        const std::vector<Define> &defines) {
+    if(cacheDir.empty()) {
+        ++misses;
+        return compileUncached(source, stage, name, defines);
+    }
+
+    // everything that changes the output, each piece null terminated so
+    // neighbouring fields cannot run into each other
+    uint64_t key = fnv1aHash(compilerVersion.c_str(), compilerVersion.size() + 1);
+    key = fnv1aHash(stageName(stage), std::strlen(stageName(stage)) + 1, key);
+    for(const auto &define : defines) {
+        key = fnv1aHash(define.name.c_str(), define.name.size() + 1, key);
+        key = fnv1aHash(define.value.c_str(), define.value.size() + 1, key);
+    }
+    key = fnv1aHash(source.data(), source.size(), key);
+
+    std::ostringstream path;
+    path << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0')
+         << key << ".spv";
+
+    std::vector<uint32_t> code = loadSpirv(path.str());
+
+    if(!code.empty()) {
+        ++hits;
+        return code;
+    }
+
+    ++misses;
+    code = compileUncached(source, stage, name, defines);
+    storeSpirv(path.str(), code);
+
+    return code;
+}
+
+/*------------------------------------------------------------------*/
+
+std::vector<uint32_t>
+ShaderCompiler::compileFile(const std::string &path,
+                            const std::vector<Define> &defines) {
+    size_t dot = path.rfind('.');
+    std::string extension = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+
+    Stage stage;
+    if(extension == "vert") {
+        stage = Stage::Vertex;
+    }
+    else if(extension == "frag") {
+        stage = Stage::Fragment;
+    }
+    else if(extension == "comp") {
+        stage = Stage::Compute;
+    }
+    else {
+        throw std::runtime_error("unknown shader stage for " + path);
+    }
+
+    return compile(readTextFile(path), stage, path, defines);
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+std::vector<uint32_t>
+ShaderCompiler::compileUncached(const std::string &source, Stage stage,
+                                const std::string &name,
+                                const std::vector<Define> &defines) {
+#ifdef HAVE_SHADERC
+    shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+    switch(stage) {
+        case Stage::Vertex:     kind = shaderc_glsl_vertex_shader;   break;
+        case Stage::Fragment:   kind = shaderc_glsl_fragment_shader; break;
+        case Stage::Compute:    kind = shaderc_glsl_compute_shader;  break;
+    }
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    for(const auto &define : defines) {
+        shaderc_compile_options_add_macro_definition(options,
+                        define.name.c_str(), define.name.size(),
+                        define.value.c_str(), define.value.size());
+    }
+
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(
+                        static_cast<shaderc_compiler_t>(shaderc),
+                        source.data(), source.size(), kind, name.c_str(),
+                        "main", options);
+    shaderc_compile_options_release(options);
+
+    if(shaderc_result_get_compilation_status(result) !=
+       shaderc_compilation_status_success) {
+        std::string error = shaderc_result_get_error_message(result);
+        shaderc_result_release(result);
+        throw std::runtime_error("failed to compile " + name + ":\n" + error);
+    }
+
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(
+                                        shaderc_result_get_bytes(result));
+    std::vector<uint32_t> code(words, words + shaderc_result_get_length(result) /
+                                              sizeof(uint32_t));
+    shaderc_result_release(result);
+
+    return code;
+#else
+    // glslc reads files, hand it the text through a temporary in a fresh
+    // directory private to this user, so no name in it can be guessed ahead
+    std::string dir = std::string(P_tmpdir) + "/shaderCompiler_XXXXXX";
+
+    if(::mkdtemp(&dir[0]) == nullptr) {
+        throw std::runtime_error("failed to create a temporary directory for " +
+                                 name + ": " + std::strerror(errno));
+    }
+
+    std::string input = dir + "/shader." + stageName(stage);
+    std::string output = dir + "/shader.spv";
+    std::string diagnostics;
+    std::vector<uint32_t> code;
+
+    std::ofstream file(input, std::ios::binary | std::ios::trunc);
+    file << source;
+    file.close();
+
+    if(file) {
+        std::vector<std::string> args;
+        for(const auto &define : defines) {
+            args.push_back("-D" + define.name + "=" + define.value);
+        }
+        args.insert(args.end(), { input, "-o", output });
+
+        if(runGlslc(args, &diagnostics, true) == 0) {
+            code = loadSpirv(output);
+        }
+    }
+    else {
+        diagnostics = "failed to write " + input;
+    }
+
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+    ::rmdir(dir.c_str());
+
+    if(code.empty()) {
+        // glslc reports against the temporary, point back at the real file
+        for(size_t at = diagnostics.find(input); at != std::string::npos;
+            at = diagnostics.find(input, at + name.size())) {
+            diagnostics.replace(at, input.size(), name);
+        }
+
+        throw std::runtime_error("failed to compile " + name + ":\n" + diagnostics);
+    }
+
+    return code;
+#endif
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// GLSL to SPIR-V compiler service
+/*------------------------------------------------------------------*/
+
+// Compiles GLSL in process with libshaderc when built with HAVE_SHADERC,
+// otherwise by running glslc ($GLSLC, default /usr/local/bin/glslc). Every
+// result is cached on disk under an FNV-1a hash of the compiler version,
+// stage, defines and source text, so unchanged shaders cost one hash and
+// one file read. #include is not supported, included files would not be
+// part of the key. compile() may be called from several threads.
+
+class ShaderCompiler {
+
+    public:
+        enum class Stage { Vertex, Fragment, Compute };
+
+        struct Define {
+            std::string name;
+            std::string value;
+        };
+
+        // empty cacheDir disables the cache. Throws std::runtime_error when
+        // no compiler is available
+        explicit ShaderCompiler(const std::string &cacheDir);
+        ~ShaderCompiler();
+
+        ShaderCompiler(const ShaderCompiler &) = delete;
+        ShaderCompiler & operator=(const ShaderCompiler &) = delete;
+
+        // throws std::runtime_error with the compiler diagnostics on failure
+        std::vector<uint32_t> compile(const std::string &source, Stage stage,
+                                      const std::string &name,
+                                      const std::vector<Define> &defines = {});
+
+        // stage from the file extension (.vert, .frag, .comp)
+        std::vector<uint32_t> compileFile(const std::string &path,
+                                          const std::vector<Define> &defines = {});
+
+        const std::string & version() const { return compilerVersion; }
+        uint64_t cacheHits() const { return hits; }
+        uint64_t compiled() const { return misses; }
+
+    private:
+        std::vector<uint32_t> compileUncached(const std::string &source,
+                                              Stage stage, const std::string &name,
+                                              const std::vector<Define> &defines);
+
+    private:
+        std::string cacheDir;
+        std::string compilerVersion;    // part of every cache key
+        void *shaderc = nullptr;        // shaderc_compiler_t with HAVE_SHADERC
+        std::atomic<uint64_t> hits {0};
+        std::atomic<uint64_t> misses {0};
+};
+
+/*------------------------------------------------------------------*/
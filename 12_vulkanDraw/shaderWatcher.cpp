@@ -0,0 +1,141 @@
+#include "shaderWatcher.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static bool
+isShaderSource(const char *name) {
+    size_t length = std::strlen(name);
+
+    auto endsWith = [&](const char *suffix) {
+        size_t suffixLength = std::strlen(suffix);
+        return length > suffixLength &&
+               std::strcmp(name + length - suffixLength, suffix) == 0;
+    };
+
+    return endsWith(".vert") || endsWith(".frag");
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+ShaderWatcher::ShaderWatcher(const std::string &dir, Callback callback)
+    : dir(dir), callback(std::move(callback)) {
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // in place writes end in close_write, editors that save by renaming a
+    // temporary file end in moved_to
+    if(inotifyFd < 0 || stopFd < 0 ||
+       ::inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::string error = std::strerror(errno);
+
+        if(inotifyFd >= 0) {
+            ::close(inotifyFd);
+        }
+        if(stopFd >= 0) {
+            ::close(stopFd);
+        }
+        throw std::runtime_error("failed to watch " + dir + ": " + error);
+    }
+
+    thread = std::thread(&ShaderWatcher::watchMain, this);
+}
+
+/*------------------------------------------------------------------*/
+
+ShaderWatcher::~ShaderWatcher() {
+    uint64_t one = 1;
+    if(::write(stopFd, &one, sizeof(one)) < 0) {
+        // the eventfd counter cannot overflow here, nothing to do
+    }
+
+    thread.join();
+
+    ::close(inotifyFd);
+    ::close(stopFd);
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+void
+ShaderWatcher::watchMain() {
+    pollfd fds[2] = {
+        { inotifyFd, POLLIN, 0 },
+        { stopFd, POLLIN, 0 }
+    };
+
+    std::vector<std::string> files;
+
+    for(;;) {
+        // block until the first event, then collect until quiet
+        int timeout = files.empty() ? -1 : DEBOUNCE_MS;
+        int ready = ::poll(fds, 2, timeout);
+
+        if(ready < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            return;
+        }
+
+        if(ready == 0) {
+            // quiet for DEBOUNCE_MS, report the batch
+            callback(files);
+            files.clear();
+            continue;
+        }
+
+        if(!readEvents(files)) {
+            return;
+        }
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+ShaderWatcher::readEvents(std::vector<std::string> &files) {
+    alignas(inotify_event) char buffer[4096];
+
+    for(;;) {
+        ssize_t length = ::read(inotifyFd, buffer, sizeof(buffer));
+
+        if(length < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+
+        for(ssize_t offset = 0; offset < length; ) {
+            const inotify_event *event =
+                        reinterpret_cast<const inotify_event *>(buffer + offset);
+
+            if(event->len > 0 && isShaderSource(event->name) &&
+               std::find(files.begin(), files.end(), event->name) == files.end()) {
+                files.emplace_back(event->name);
+            }
+
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+
+/*------------------------------------------------------------------*/
+// Shader source directory watcher
+/*------------------------------------------------------------------*/
+
+// Watches a directory with inotify on a background thread and reports
+// GLSL sources (.vert, .frag) that were written or moved into place.
+// Editors touch a file several times per save, events are collected until
+// the directory has been quiet for DEBOUNCE_MS and every changed file is
+// reported once. The callback runs on the watcher thread, so it can do the
+// slow part (compiling, building pipelines) without a thread of its own.
+
+class ShaderWatcher {
+
+    public:
+        using Callback = std::function<void(const std::vector<std::string> &files)>;
+
+        static const int DEBOUNCE_MS = 50;
+
+        // throws std::runtime_error if the directory cannot be watched
+        ShaderWatcher(const std::string &dir, Callback callback);
+        ~ShaderWatcher();
+
+        ShaderWatcher(const ShaderWatcher &) = delete;
+        ShaderWatcher & operator=(const ShaderWatcher &) = delete;
+
+        const std::string & directory() const { return dir; }
+
+    private:
+        void watchMain();
+        bool readEvents(std::vector<std::string> &files);
+
+    private:
+        std::string dir;
+        Callback callback;
+        int inotifyFd = -1;
+        int stopFd = -1;                // eventfd, wakes the thread to exit
+        std::thread thread;
+};
+
+/*------------------------------------------------------------------*/
@@ -1,11 +1,14 @@
 #version 450
 
-vec2 positions[3] = vec2[](
-                                vec2(0.0, -0.5),
-                                vec2(0.5, 0.5),
-                                vec2(-0.5, 0.5)
-                          );
+// Vertex::attributeDescriptions(), colour unused
+layout(location = 0) in vec2 inPosition;
+
+// DrawUniforms, dynamic offset per draw
+layout(set = 0, binding = 0) uniform DrawUniforms {
+    mat4 transform;
+    float time;
+} draw;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    gl_Position = draw.transform * vec4(inPosition, 0.0, 1.0);
 }
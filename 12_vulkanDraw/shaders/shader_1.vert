@@ -2,20 +2,19 @@
 
 // glslc shader_1.vert -o vert.spv
 
-layout(location = 0) out vec3 fragColor;
+// Vertex::attributeDescriptions()
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// DrawUniforms, dynamic offset per draw
+layout(set = 0, binding = 0) uniform DrawUniforms {
+    mat4 transform;
+    float time;
+} draw;
 
-vec2 positions[3] = vec2[](
-                                vec2(0.0, -0.5),
-                                vec2(0.5, 0.5),
-                                vec2(-0.5, 0.5)
-                          );
+layout(location = 0) out vec3 fragColor;
 
-vec3 colors[3] = vec3[] (
-                vec3(1.0, 0.0, 0.0),
-                vec3(0.0, 1.0, 0.0),
-                vec3(0.0, 0.0, 1.0)
-                );
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    gl_Position = draw.transform * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
 }
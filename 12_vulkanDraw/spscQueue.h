@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+/*------------------------------------------------------------------*/
+// Single producer single consumer lock-free queue
+/*------------------------------------------------------------------*/
+
+// Bounded ring buffer for handing messages from exactly one producer
+// thread to exactly one consumer thread without locks. Capacity must be a
+// power of two; one slot is kept free to tell full from empty.
+
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+    public:
+        // producer side, returns false if the queue is full
+        bool push(const T &item) {
+            size_t tail = tailIdx.load(std::memory_order_relaxed);
+            size_t next = (tail + 1) & (Capacity - 1);
+
+            if(next == headIdx.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            items[tail] = item;
+
+            // publish the item to the consumer
+            tailIdx.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, returns false if the queue is empty
+        bool pop(T &item) {
+            size_t head = headIdx.load(std::memory_order_relaxed);
+
+            if(head == tailIdx.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            item = items[head];
+
+            // hand the slot back to the producer
+            headIdx.store((head + 1) & (Capacity - 1), std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, true if there is nothing to pop right now
+        bool empty() const {
+            return headIdx.load(std::memory_order_relaxed) ==
+                   tailIdx.load(std::memory_order_acquire);
+        }
+
+    private:
+        // producer and consumer indices on separate cache lines so the two
+        // threads do not invalidate each other on every operation
+        alignas(64) std::atomic<size_t> headIdx {0};     // next item to pop
+        alignas(64) std::atomic<size_t> tailIdx {0};     // next slot to push
+        alignas(64) std::array<T, Capacity> items {};
+};
+
+/*------------------------------------------------------------------*/
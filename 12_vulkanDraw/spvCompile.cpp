@@ -0,0 +1,121 @@
+// build tool: GLSL to SPIR-V through ShaderCompiler and its cache
+//
+//      spvCompile [--cache DIR] [--no-cache] [-DNAME[=VALUE]]... IN OUT [IN OUT]...
+//
+// stage from the IN extension (.vert, .frag, .comp). OUT ending in .inc gets
+// the comma separated word list of glslc -mfmt=num, included by
+// embeddedShaders.h, anything else the binary module. Unchanged sources are
+// served from the cache (default shader_cache) without compiling
+
+#include "shaderCompiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+/*------------------------------------------------------------------*/
+
+static bool
+endsWith(const std::string &text, const char *suffix) {
+    size_t length = std::strlen(suffix);
+    return text.size() >= length &&
+           text.compare(text.size() - length, length, suffix) == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+static void
+writeSpirv(const std::string &path, const std::vector<uint32_t> &code) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if(endsWith(path, ".inc")) {
+        // same layout as glslc -mfmt=num
+        file << std::hex << std::setfill('0');
+        for(size_t i = 0; i < code.size(); ++i) {
+            file << "0x" << std::setw(8) << code[i] << ",";
+            file << ((i % 8 == 7 || i + 1 == code.size()) ? '\n' : ' ');
+        }
+    }
+    else {
+        file.write(reinterpret_cast<const char *>(code.data()),
+                   code.size() * sizeof(uint32_t));
+    }
+
+    if(!file) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+int
+main(int argc, char *argv[]) {
+    std::string cacheDir = "shader_cache";
+    std::vector<ShaderCompiler::Define> defines;
+    std::vector<std::string> files;
+
+    for(int i = 1; i < argc; ++i) {
+        if(std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--no-cache") == 0) {
+            cacheDir.clear();
+        }
+        else if(std::strncmp(argv[i], "-D", 2) == 0) {
+            std::string define = argv[i] + 2;
+            size_t equals = define.find('=');
+
+            if(equals == std::string::npos) {
+                defines.push_back({ define, "" });
+            }
+            else {
+                defines.push_back({ define.substr(0, equals),
+                                    define.substr(equals + 1) });
+            }
+        }
+        else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if(files.empty() || files.size() % 2 != 0) {
+        std::cerr << "usage: " << argv[0] << " [--cache DIR] [--no-cache]"
+                  << " [-DNAME[=VALUE]]... IN OUT [IN OUT]..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        auto startTime = std::chrono::steady_clock::now();
+
+        ShaderCompiler compiler(cacheDir);
+
+        for(size_t i = 0; i < files.size(); i += 2) {
+            writeSpirv(files[i + 1], compiler.compileFile(files[i], defines));
+        }
+
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - startTime).count();
+
+        std::cout << INTENT_STR << "spvCompile: " << files.size() / 2
+                  << " shaders, " << compiler.cacheHits() << " cached, "
+                  << compiler.compiled() << " compiled in " << std::fixed
+                  << std::setprecision(2) << ms << " ms" << std::endl;
+    } catch(const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,255 @@
+#include "startupProfiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <ctime>
+
+static const char INTENT_SPACE     = '\t';
+static const char * INTENT_STR     = "...";
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static std::string
+jsonString(const std::string &value) {
+    std::string quoted = "\"";
+
+    for(char c : value) {
+        if(c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if(static_cast<unsigned char>(c) < 0x20) {
+            quoted += ' ';      // no control characters in names
+        }
+        else {
+            quoted += c;
+        }
+    }
+
+    return quoted + "\"";
+}
+
+/*------------------------------------------------------------------*/
+
+// phases of one history line. Only reads what toJson() writes, lines it
+// cannot make sense of yield no phases and are skipped
+static std::vector<StartupProfiler::Phase>
+parsePhases(const std::string &line) {
+    std::vector<StartupProfiler::Phase> phases;
+    const std::string nameKey = "{\"name\":\"";
+    const std::string msKey = "\",\"ms\":";
+
+    size_t pos = line.find("\"phases\":");
+
+    while(pos != std::string::npos) {
+        pos = line.find(nameKey, pos);
+        if(pos == std::string::npos) {
+            break;
+        }
+
+        size_t nameStart = pos + nameKey.size();
+        size_t nameEnd = line.find(msKey, nameStart);
+        if(nameEnd == std::string::npos) {
+            break;
+        }
+
+        const char *msStart = line.c_str() + nameEnd + msKey.size();
+        char *msEnd = nullptr;
+        double ms = std::strtod(msStart, &msEnd);
+        if(msEnd == msStart) {
+            break;
+        }
+
+        phases.push_back({ line.substr(nameStart, nameEnd - nameStart), ms });
+        pos = static_cast<size_t>(msEnd - line.c_str());
+    }
+
+    return phases;
+}
+
+/*------------------------------------------------------------------*/
+
+static double
+median(std::vector<double> values) {
+    if(values.empty()) {
+        return 0.0;
+    }
+
+    size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    return values[mid];
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+StartupProfiler::Scope::~Scope() {
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    profiler.record(name, elapsed.count());
+}
+
+/*------------------------------------------------------------------*/
+
+void
+StartupProfiler::note(const std::string &key, const std::string &value) {
+    notes.emplace_back(key, value);
+}
+
+/*------------------------------------------------------------------*/
+
+double
+StartupProfiler::totalMs() const {
+    double total = 0.0;
+
+    for(const auto &phase : phaseList) {
+        total += phase.ms;
+    }
+
+    return total;
+}
+
+/*------------------------------------------------------------------*/
+
+std::string
+StartupProfiler::toJson() const {
+    std::ostringstream json;
+
+    json << std::fixed << std::setprecision(3);
+    json << "{\"timestamp\":" << static_cast<long long>(std::time(nullptr));
+
+    json << ",\"notes\":{";
+    for(size_t i = 0; i < notes.size(); ++i) {
+        json << (i == 0 ? "" : ",") << jsonString(notes[i].first) << ":"
+             << jsonString(notes[i].second);
+    }
+    json << "}";
+
+    json << ",\"phases\":[";
+    for(size_t i = 0; i < phaseList.size(); ++i) {
+        json << (i == 0 ? "" : ",") << "{\"name\":" << jsonString(phaseList[i].name)
+             << ",\"ms\":" << phaseList[i].ms << "}";
+    }
+    json << "]";
+
+    json << ",\"totalMs\":" << totalMs() << "}";
+
+    return json.str();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+StartupProfiler::print() const {
+    double total = totalMs();
+
+    std::cout << INTENT_STR << "startup phases (ms):" << std::endl;
+    for(const auto &phase : phaseList) {
+        std::cout << INTENT_SPACE << INTENT_STR << std::left << std::setw(28)
+                  << phase.name << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(10) << phase.ms
+                  << std::setprecision(1) << std::setw(7)
+                  << (total > 0.0 ? 100.0 * phase.ms / total : 0.0) << " %"
+                  << std::endl;
+    }
+    std::cout << INTENT_SPACE << INTENT_STR << std::left << std::setw(28)
+              << "total" << std::right << std::setprecision(3) << std::setw(10)
+              << total << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+StartupProfiler::writeReport(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+
+    file << toJson() << std::endl;
+
+    if(!file) {
+        throw std::runtime_error("failed to write startup report " + path);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+StartupProfiler::appendHistory(const std::string &path) const {
+    // earlier runs, per phase name
+    std::map<std::string, std::vector<double>> history;
+    size_t runs = 0;
+
+    std::ifstream in(path);
+    std::string line;
+
+    while(std::getline(in, line)) {
+        std::vector<Phase> phases = parsePhases(line);
+        if(phases.empty()) {
+            continue;
+        }
+
+        for(const auto &phase : phases) {
+            history[phase.name].push_back(phase.ms);
+        }
+        ++runs;
+    }
+    in.close();
+
+    std::ofstream out(path, std::ios::app);
+    out << toJson() << std::endl;
+
+    if(!out) {
+        throw std::runtime_error("failed to append startup history " + path);
+    }
+
+    // summary over all runs including this one, regressions against the
+    // earlier runs only
+    std::cout << INTENT_STR << "startup history (" << runs + 1 << " runs, ms):"
+              << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << std::left << std::setw(28)
+              << "phase" << std::right << std::setw(10) << "this run"
+              << std::setw(10) << "min" << std::setw(10) << "median"
+              << std::setw(10) << "max" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    for(const auto &phase : phaseList) {
+        std::vector<double> &earlier = history[phase.name];
+        double earlierMedian = median(earlier);
+
+        std::vector<double> all = earlier;
+        all.push_back(phase.ms);
+
+        bool regressed = !earlier.empty() &&
+                         phase.ms > earlierMedian * REGRESSION_FACTOR &&
+                         phase.ms - earlierMedian > REGRESSION_MIN_MS;
+
+        std::cout << INTENT_SPACE << INTENT_STR << std::left << std::setw(28)
+                  << phase.name << std::right << std::setw(10) << phase.ms
+                  << std::setw(10) << *std::min_element(all.begin(), all.end())
+                  << std::setw(10) << median(all)
+                  << std::setw(10) << *std::max_element(all.begin(), all.end())
+                  << (regressed ? "  <-- slower than median" : "")
+                  << std::endl;
+    }
+
+    std::cout << std::defaultfloat;
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+void
+StartupProfiler::record(const char *name, double ms) {
+    phaseList.push_back({ name, ms });
+}
+
+/*------------------------------------------------------------------*/
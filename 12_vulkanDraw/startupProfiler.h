@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <utility>
+
+/*------------------------------------------------------------------*/
+// Startup phase profiler
+/*------------------------------------------------------------------*/
+
+// Times the steps of application startup with scoped steady clock timers.
+// The result is written as a json report, and appended as one json line to
+// a history file that is summarized across runs (min/median/max per phase)
+// so a phase that got slower stands out.
+
+class StartupProfiler {
+
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // measures from construction to destruction and records the phase
+        class Scope {
+            public:
+                Scope(StartupProfiler &profiler, const char *name)
+                    : profiler(profiler), name(name), start(Clock::now()) {}
+                ~Scope();
+
+                Scope(const Scope &) = delete;
+                Scope & operator=(const Scope &) = delete;
+
+            private:
+                StartupProfiler &profiler;
+                const char *name;
+                Clock::time_point start;
+        };
+
+        struct Phase {
+            std::string name;
+            double ms;
+        };
+
+        // key/value pair written into the report, e.g. the device name
+        void note(const std::string &key, const std::string &value);
+
+        const std::vector<Phase> & phases() const { return phaseList; }
+        double totalMs() const;
+
+        // phases and notes as a json object, no trailing newline
+        std::string toJson() const;
+
+        // print the phases of this run in order with their share of the total
+        void print() const;
+
+        // write toJson() to path, throws std::runtime_error on failure
+        void writeReport(const std::string &path) const;
+
+        // append this run to path and print every phase aggregated over all
+        // runs recorded there. Phases more than REGRESSION_FACTOR slower than
+        // the median of earlier runs are flagged
+        void appendHistory(const std::string &path) const;
+
+        static constexpr double REGRESSION_FACTOR = 1.5;
+        static constexpr double REGRESSION_MIN_MS = 1.0;  // ignore jitter on
+                                                          // tiny phases
+
+    private:
+        void record(const char *name, double ms);
+
+    private:
+        std::vector<Phase> phaseList;
+        std::vector<std::pair<std::string, std::string>> notes;
+};
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,102 @@
+#include "uniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+/*------------------------------------------------------------------*/
+// Local Helpers
+/*------------------------------------------------------------------*/
+
+static VkDeviceSize
+alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+UniformRing::UniformRing(DeviceMemoryAllocator &allocator,
+                         const DeviceCapabilities &caps,
+                         uint32_t partitionCount, VkDeviceSize blockSize,
+                         uint32_t blockCount)
+    : allocator(allocator),
+      // partitions also start on an atom, so flushing one never touches the
+      // partition the gpu may be reading next to it. Both are powers of two
+      alignment(std::max<VkDeviceSize>({
+                    caps.properties.limits.minUniformBufferOffsetAlignment,
+                    caps.properties.limits.nonCoherentAtomSize, 1 })),
+      partitionBytes(alignUp(blockSize, alignment) * std::max(blockCount, 1u)),
+      partitions(partitionCount) {
+
+    // dynamic offsets are 32 bit
+    if(partitions == 0 || partitionBytes * partitions > UINT32_MAX) {
+        throw std::runtime_error("uniform ring size out of range!");
+    }
+
+    VkBufferCreateInfo bufferInfo {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = partitionBytes * partitions;
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // written once per frame and read once by the gpu, device local host
+    // visible memory (resizable bar) saves the pci reads where there is one
+    memory = allocator.createBuffer(bufferInfo,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    ringBuffer);
+}
+
+/*------------------------------------------------------------------*/
+
+UniformRing::~UniformRing() {
+    allocator.destroyBuffer(ringBuffer, memory);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+UniformRing::begin(uint32_t partition) {
+    base = (partition % partitions) * partitionBytes;
+    head.store(0, std::memory_order_relaxed);
+}
+
+/*------------------------------------------------------------------*/
+
+UniformRing::Block
+UniformRing::allocate(VkDeviceSize size) {
+    VkDeviceSize aligned = alignUp(size, alignment);
+    VkDeviceSize offset = head.fetch_add(aligned, std::memory_order_relaxed);
+
+    if(offset + aligned > partitionBytes) {
+        throw std::runtime_error("uniform ring partition is full!");
+    }
+
+    Block block;
+        block.data = static_cast<char *>(memory.mapped) + base + offset;
+        block.offset = static_cast<uint32_t>(base + offset);
+
+    return block;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+UniformRing::end() {
+    VkDeviceSize used = std::min(head.load(std::memory_order_relaxed),
+                                 partitionBytes);
+
+    peak = std::max(peak, used);
+    allocator.flush(memory, base, used);
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+UniformRing::coherent() const {
+    return (memory.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+/*------------------------------------------------------------------*/
@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
+#include <GLFW/glfw3.h>
+
+#include "deviceCapabilities.h"
+#include "deviceMemory.h"
+
+#include <atomic>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Per frame uniform ring buffer
+/*------------------------------------------------------------------*/
+
+// One host visible uniform buffer, mapped for its whole life and split into
+// equal partitions, one per frame in flight (or pre-recorded image). A frame
+// bump allocates its uniform blocks from its partition and binds them with
+// a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offset, so one descriptor set
+// covers every draw and nothing is mapped or updated per frame. Offsets are
+// minUniformBufferOffsetAlignment aligned. A partition may only be begun
+// once the gpu is done with the frame that last used it. allocate() is
+// lock free and may be called from recording threads.
+
+class UniformRing {
+
+    public:
+        struct Block {
+            void *data = nullptr;       // write only, flushed by end()
+            uint32_t offset = 0;        // dynamic offset into buffer()
+        };
+
+        // room for blockCount blocks of blockSize per partition
+        UniformRing(DeviceMemoryAllocator &allocator, const DeviceCapabilities &caps,
+                    uint32_t partitionCount, VkDeviceSize blockSize,
+                    uint32_t blockCount);
+        ~UniformRing();
+
+        UniformRing(const UniformRing &) = delete;
+        UniformRing & operator=(const UniformRing &) = delete;
+
+        void begin(uint32_t partition);             // rewinds it
+        Block allocate(VkDeviceSize size);          // throws when full
+        void end();                                 // flush what was written
+
+        VkBuffer buffer() const { return ringBuffer; }
+        uint32_t partitionCount() const { return partitions; }
+        VkDeviceSize partitionSize() const { return partitionBytes; }
+        VkDeviceSize peakBytes() const { return peak; }   // in one partition
+        bool coherent() const;
+
+    private:
+        DeviceMemoryAllocator &allocator;
+        VkBuffer ringBuffer = VK_NULL_HANDLE;
+        DeviceMemoryAllocator::Allocation memory;   // mapped for life
+        VkDeviceSize alignment;
+        VkDeviceSize partitionBytes;
+        uint32_t partitions;
+
+        VkDeviceSize base = 0;                      // current partition
+        std::atomic<VkDeviceSize> head {0};         // relative to base
+        VkDeviceSize peak = 0;
+};
+
+/*------------------------------------------------------------------*/
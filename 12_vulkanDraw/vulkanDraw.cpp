@@ -1,13 +1,27 @@
 #include "vulkanDraw.h"
+#include "embeddedShaders.h"
+#include "fileView.h"
+#include "fnv1a.h"
+#include "instanceEnumeration.h"
+#include "shaderWatcher.h"
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cassert>
-#include <unordered_set>
 #include <set>
 #include <algorithm>
 #include <fstream>
+#include <optional>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
 
 /*------------------------------------------------------------------*/
 // Constants
@@ -16,10 +30,27 @@
 static const char INTENT_SPACE     = '\t';
 static const char * INTENT_STR     = "...";
 
-static const uint32_t WIDTH     = 800;
-static const uint32_t HEIGHT    = 600;
 static const char * TITLE       = "12_vulkanDraw";
 
+// headless render target format, a mandatory color attachment format that
+// matches the preferred swapchain format
+static const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+
+// idle waits time out to keep --frames and --resize-stress progressing
+static const double EVENT_WAIT_TIMEOUT_SEC = 0.1;
+
+// os sleeps overshoot by up to a scheduler tick, the frame limiter sleeps
+// until this margin before the deadline and spins the rest
+static const std::chrono::microseconds FRAME_SPIN_MARGIN(1000);
+
+// pick this device instead of the best scored one: an index into the
+// enumeration order or part of the device name
+static const char * DEVICE_OVERRIDE_ENV = "VULKAN_DRAW_DEVICE";
+
+// --calibrate-devices fills a device local buffer this large this many times
+static const VkDeviceSize CALIBRATION_BUFFER_SIZE = 64ull << 20;
+static const uint32_t CALIBRATION_FILLS = 8;
+
 // construct validation layer name array
 std::vector<const char *> validationLayer = {
     "VK_LAYER_KHRONOS_validation"
@@ -41,31 +72,100 @@ std::vector<const char *> deviceExtensions = {
 // Classes
 /*------------------------------------------------------------------*/
 
-struct QueueFamilyIndices {
-    std::optional<uint32_t> graphicsFamily;
-    std::optional<uint32_t> presentFamily;
-
-    bool isComplete() const {
-        return graphicsFamily.has_value() && presentFamily.has_value();
-    }
+// pipeline cache file layout: this header followed by the driver's cache
+// data. The driver checks its own header, but a truncated or torn write
+// can still crash some drivers, so the data is checksummed as well
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;           // bumped when this layout changes
+    uint64_t dataSize;
+    uint64_t dataHash;          // fnv-1a of the cache data
 };
 
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x43505644;   // "DVPC"
+static const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+// shader sets variants can pick from: embedded code, the file names
+// compileShaders.sh writes for the --shader-dir override and the glsl
+// sources --hot-reload watches
+struct ShaderSet {
+    const uint32_t *vertCode;
+    size_t vertCodeSize;
+    const uint32_t *fragCode;
+    size_t fragCodeSize;
+    const char *vertFile;
+    const char *fragFile;
+    const char *vertSource;
+    const char *fragSource;
+};
 
-struct SwapchainSupportDetails {
-    VkSurfaceCapabilitiesKHR capabilities;
-    std::vector<VkSurfaceFormatKHR> formats;
-    std::vector<VkPresentModeKHR> presentModes;
+static const ShaderSet SHADER_SETS[] = {
+    { EMBEDDED_VERT_SPV, sizeof(EMBEDDED_VERT_SPV),
+      EMBEDDED_FRAG_SPV, sizeof(EMBEDDED_FRAG_SPV),
+      "vert.spv", "frag.spv", "shader.vert", "shader.frag" },
+    { EMBEDDED_VERT_01_SPV, sizeof(EMBEDDED_VERT_01_SPV),
+      EMBEDDED_FRAG_01_SPV, sizeof(EMBEDDED_FRAG_01_SPV),
+      "vert_01.spv", "frag_01.spv", "shader_1.vert", "shader_1.frag" }
 };
 
+static const uint32_t SHADER_SET_COUNT = sizeof(SHADER_SETS) / sizeof(SHADER_SETS[0]);
+
 /*------------------------------------------------------------------*/
 // Public inferface definitions
 /*------------------------------------------------------------------*/
 
+const char *
+presentPolicyName(PresentPolicy policy) {
+    switch(policy) {
+        case PresentPolicy::LowLatency: return "latency";
+        case PresentPolicy::LowPower:   return "power";
+        case PresentPolicy::TearFree:   return "tearfree";
+        case PresentPolicy::Immediate:  return "immediate";
+    }
+    return "unknown";
+}
+
+/*------------------------------------------------------------------*/
+
+HelloTriangleApplication::HelloTriangleApplication(const AppConfig &appConfig)
+    : config(appConfig) {
+    if(config.framesInFlight == 0) {
+        throw std::runtime_error("frames in flight must be at least 1");
+    }
+
+    if(config.hostAllocator) {
+        hostAllocator = std::make_unique<HostAllocator>();
+        pAllocator = hostAllocator->callbacks();
+    }
+}
+
+/*------------------------------------------------------------------*/
+
 void
 HelloTriangleApplication::run() {
     initVulkan();
     mainLoop();
     cleanup();
+
+    // everything is destroyed, anything still live is a leak
+    if(hostAllocator) {
+        hostAllocator->print();
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::setCaptureCallback(CaptureCallback callback) {
+    captureCallback = std::move(callback);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::setPresentPolicy(PresentPolicy policy) {
+    config.presentPolicy = policy;
+    presentPolicyChanged = true;
 }
 
 /*------------------------------------------------------------------*/
@@ -168,419 +268,671 @@ destroyDebugUtilsMessengerEXT(
 
 /*------------------------------------------------------------------*/
 
-static std::vector<std::string>
-getSupportedExtensions() {
-    uint32_t supportedExtCount = 0;
-
-    vkEnumerateInstanceExtensionProperties(
-        nullptr,
-        &supportedExtCount,
-        nullptr
-    );
+static std::vector<const char *>
+getRequiredExtensions(bool headless) {
+    std::vector<const char *> requiredExtensions;
 
-    assert(supportedExtCount > 0);
+    // surface extensions are only needed to present to a window
+    if(!headless) {
+        uint32_t glfwRequiredExtCount = 0;
+        const char ** glfwRequiredExtensions;
 
-    // allocate buffer to hold all names
-    std::vector<VkExtensionProperties> supportedExtProperties(supportedExtCount);
+        glfwRequiredExtensions = glfwGetRequiredInstanceExtensions(
+                                        &glfwRequiredExtCount);
 
-    // call again but with buffer to get all properties
-    vkEnumerateInstanceExtensionProperties(
-        nullptr,
-        &supportedExtCount,
-        supportedExtProperties.data()
-    );
+        requiredExtensions.assign(glfwRequiredExtensions,
+                                  glfwRequiredExtensions + glfwRequiredExtCount);
 
-    std::vector<std::string> supportedExtNames;
+        assert(glfwRequiredExtCount > 0);
+    }
 
-    for(auto &property : supportedExtProperties) {
-        supportedExtNames.emplace_back(property.extensionName);
+    // add optional message callback
+    if(enableValidationLayers) {
+        requiredExtensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        printNames(requiredExtensions, "Required Extension Names");
     }
 
-    #ifndef NDEBUG
-        printNames(supportedExtNames, "Supported Extension Names");
-    #endif
+    return requiredExtensions;
+}
+
+/*------------------------------------------------------------------*/
+
+static uint32_t
+getInstanceApiVersion() {
+    // vkEnumerateInstanceVersion does not exist in a vulkan 1.0 loader,
+    // look it up instead of linking against it
+    auto func = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(
+                        VK_NULL_HANDLE,
+                        "vkEnumerateInstanceVersion");
+
+    uint32_t version = VK_API_VERSION_1_0;
+
+    if(func != nullptr) {
+        func(&version);
+    }
 
-    return supportedExtNames;
+    return version;
 }
 
 /*------------------------------------------------------------------*/
 
 static bool
-checkGLFWExtensionSupport(std::vector<const char *> &reqExt,
-                          std::vector<std::string> supportedExt) {
-
-    std::unordered_set<std::string> supportedExtSet(supportedExt.begin(), supportedExt.end());
-    for(auto ext : reqExt) {
-        if(supportedExtSet.count(ext) == 0) {
-           return false;
-        }
+isDeviceSuitable(const DeviceCapabilities &caps, bool headless) {
+    // headless rendering needs neither the swapchain extension nor a surface
+    if(headless) {
+        return caps.queueFamilyIndices.isComplete();
     }
-    return true;
+
+    bool extsSupported = std::all_of(deviceExtensions.begin(),
+                                     deviceExtensions.end(),
+                                     [&caps](const char *name) {
+                                         return caps.hasExtension(name);
+                                     });
+
+    bool swapchainAdequate = !caps.swapchainSupport.formats.empty() &&
+                             !caps.swapchainSupport.presentModes.empty();
+
+    return caps.queueFamilyIndices.isComplete() && extsSupported &&
+           swapchainAdequate;
 }
 
 /*------------------------------------------------------------------*/
 
-static std::vector<std::string>
-getSupportedValidationLayerNames() {
+static void printDeviceSpecification(const DeviceCapabilities &caps) {
+    const VkPhysicalDeviceProperties &deviceProperties = caps.properties;
+    const VkPhysicalDeviceFeatures &deviceFeatures = caps.features;
 
-    uint32_t layerCnt = 0;
+    // print them
+    std::cout << INTENT_STR << "Current Device Property: " << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Device Name: " << deviceProperties.deviceName << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Device VendorID: " << deviceProperties.vendorID << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Device Type: " << deviceProperties.deviceType << std::endl;
 
-    vkEnumerateInstanceLayerProperties(
-                    &layerCnt,
-                    nullptr
-                    );
+    // print them
+    std::cout << INTENT_STR << "Current Device Features: " << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Geometry Shader :" << deviceFeatures.geometryShader << std::endl;
 
-    // allocate buffer to hold layer names
-    std::vector<VkLayerProperties> availableLayers(layerCnt);
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Shader Float64 :" << deviceFeatures.shaderFloat64 << std::endl;
 
-    // call again but with buffer to get all layer names
-    vkEnumerateInstanceLayerProperties(
-                    &layerCnt,
-                    availableLayers.data()
-                    );
+    std::cout << INTENT_SPACE << INTENT_STR
+              << "Shader Int64 :" << deviceFeatures.shaderInt64 << std::endl;
+}
 
-    std::vector<std::string> layerNames;
+/*------------------------------------------------------------------*/
 
-    for(auto & property : availableLayers) {
-        layerNames.emplace_back(property.layerName);
+static VkSurfaceFormatKHR
+chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR> &availableFormats) {
+    for( const auto & curAvailableFormat : availableFormats) {
+        if(curAvailableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
+           curAvailableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return curAvailableFormat;
+        }
     }
 
-    #ifndef NDEBUG
-        printNames(layerNames, "Available Layer Names");
-    #endif
-    return layerNames;
+    return availableFormats[0];
 }
 
 /*------------------------------------------------------------------*/
 
-static bool
-checkValidationLayerSupport(std::vector<const char *> & reqLayers,
-                            std::vector<std::string> & availableLayers) {
+static const char *
+presentModeName(VkPresentModeKHR presentMode) {
+    switch(presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:     return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:       return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:          return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:  return "FIFO_RELAXED";
+        default:                                return "UNKNOWN";
+    }
+}
 
-    std::unordered_set availableLayersSet(
-                availableLayers.begin(), availableLayers.end());
+/*------------------------------------------------------------------*/
 
-    for(auto & reqLayerName : reqLayers) {
-        if(availableLayersSet.count(reqLayerName) == 0) {
-            return false;
+static VkPresentModeKHR
+chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes,
+                      PresentPolicy policy) {
+    // present modes in order of preference for each policy
+    std::vector<VkPresentModeKHR> preferred;
+
+    switch(policy) {
+        case PresentPolicy::LowLatency:
+            preferred = { VK_PRESENT_MODE_MAILBOX_KHR,
+                          VK_PRESENT_MODE_IMMEDIATE_KHR,
+                          VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+            break;
+        case PresentPolicy::LowPower:
+            // fifo only, nothing is rendered that will not be shown
+            break;
+        case PresentPolicy::TearFree:
+            preferred = { VK_PRESENT_MODE_MAILBOX_KHR };
+            break;
+        case PresentPolicy::Immediate:
+            preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR,
+                          VK_PRESENT_MODE_MAILBOX_KHR };
+            break;
+    }
+
+    for(auto presentMode : preferred) {
+        if(std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                     presentMode) != availablePresentModes.end()) {
+            return presentMode;
         }
     }
 
-    return true;
+    // FIFO is the only mode guaranteed to be available
+    return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 /*------------------------------------------------------------------*/
 
-static std::vector<const char *>
-getRequiredExtensions() {
-    uint32_t glfwRequiredExtCount = 0;
-    const char ** glfwRequiredExtensions;
-
-    glfwRequiredExtensions = glfwGetRequiredInstanceExtensions(
-                                    &glfwRequiredExtCount);
+static VkExtent2D
+chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities,
+                 const VkExtent2D &framebufferExtent) {
+    auto &curExtent = capabilities.currentExtent;
+    if(curExtent.width != std::numeric_limits<uint32_t>::max()) {
+        return curExtent;
+    }
+    else {
+        // framebuffer size is tracked from glfw events, glfw itself may only
+        // be queried from the main thread
+        VkExtent2D actualExtent = framebufferExtent;
 
-    std::vector<const char *> requiredExtensions(
-                                glfwRequiredExtensions,
-                                glfwRequiredExtensions + glfwRequiredExtCount);
+        actualExtent.width = std::clamp(actualExtent.width,
+                                       capabilities.minImageExtent.width,
+                                       capabilities.maxImageExtent.width);
 
-    assert(glfwRequiredExtCount > 0);
+        actualExtent.height = std::clamp(actualExtent.height,
+                                       capabilities.minImageExtent.height,
+                                       capabilities.maxImageExtent.height);
 
-    // add optional message callback
-    if(enableValidationLayers) {
-        requiredExtensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-        printNames(requiredExtensions, "Required Extension Names");
+        return actualExtent;
     }
-
-    return requiredExtensions;
 }
 
 /*------------------------------------------------------------------*/
 
 static bool
-checkDeviceExtSupported(VkPhysicalDevice & device) {
-    // extension count
-    uint32_t extCnt = 0;
-
-    // enumerate Device extension properties
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extCnt, nullptr);
+tryFindMemoryType(const VkPhysicalDeviceMemoryProperties &memProperties,
+                  uint32_t typeFilter, VkMemoryPropertyFlags properties,
+                  uint32_t &typeIdx) {
+    for(uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        if((typeFilter & (1u << i)) &&
+           (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            typeIdx = i;
+            return true;
+        }
+    }
 
-    assert(extCnt > 0);
+    return false;
+}
 
-    // allocate buffer to hold extension names
-    std::vector<VkExtensionProperties> availableExts(extCnt);
+/*------------------------------------------------------------------*/
 
-    // enumerate Device extension properties
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extCnt,
-                                        availableExts.data());
+static uint32_t
+findMemoryType(const VkPhysicalDeviceMemoryProperties &memProperties,
+               uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    uint32_t typeIdx = 0;
 
-    std::set<std::string> availableExtsSet;
-    for(auto e : availableExts) {
-        availableExtsSet.insert(e.extensionName);
+    if(!tryFindMemoryType(memProperties, typeFilter, properties, typeIdx)) {
+        throw std::runtime_error("failed to find suitable memory type!");
     }
 
-    #ifndef NDEBUG
-        for_each(availableExts.begin(), availableExts.end(),
-                 [](auto &e) {
-                    std::cout << INTENT_SPACE << INTENT_STR
-                              << e.extensionName << std::endl;
-                             });
-    #endif
-
-    for(auto & e : deviceExtensions) {
-        if(availableExtsSet.count(e) == 0)
-            return false;
-     }
-
-    return true;
+    return typeIdx;
 }
 
 /*------------------------------------------------------------------*/
 
-static QueueFamilyIndices
-findQueueFamilies(VkPhysicalDevice &device, VkSurfaceKHR &surface) {
-    QueueFamilyIndices indices;
+static void
+printBufferUpload(const char *what, const BufferUploader::Timing &timing,
+                  uint64_t overlappedFrames) {
+    // staging: host memcpy into mapped memory. transfer: submit until the
+    // copies were seen complete, for async uploads at frame granularity
+    double bytes = static_cast<double>(timing.bytes);
+    double stagingSec = timing.stagingMs / 1000.0;
+    double transferSec = timing.transferMs / 1000.0;
+
+    std::cout << INTENT_STR << what << " upload: " << timing.buffers << " buffers, "
+              << bytes / (1024.0 * 1024.0) << " MiB, staging "
+              << timing.stagingMs << " ms ("
+              << (stagingSec > 0.0 ? bytes / stagingSec / 1e9 : 0.0) << " GB/s), transfer "
+              << timing.transferMs << " ms ("
+              << (transferSec > 0.0 ? bytes / transferSec / 1e9 : 0.0) << " GB/s), "
+              << overlappedFrames << " frames rendered meanwhile" << std::endl;
+}
 
-    // let us get Queue family properties
-    uint32_t qFamilyCnt = 0;
+/*------------------------------------------------------------------*/
 
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &qFamilyCnt, nullptr);
+// score parts, logged per candidate so a surprising pick can be explained
+struct DeviceScore {
+    uint32_t type = 0;          // discrete > integrated > virtual > cpu
+    uint32_t memory = 0;        // largest device local heap
+    uint32_t imageSize = 0;     // maxImageDimension2D
+    uint32_t queues = 0;        // dedicated compute/transfer families
+    uint32_t calibration = 0;   // measured fill bandwidth, optional
 
-    if(qFamilyCnt == 0) {
-        throw std::runtime_error("No queue family properties found");
+    uint32_t total() const {
+        return type + memory + imageSize + queues + calibration;
     }
+};
 
-    // allocate buffer to hold queue family properties
-    std::vector<VkQueueFamilyProperties> qFamilies(qFamilyCnt);
-
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &qFamilyCnt, qFamilies.data());
+/*------------------------------------------------------------------*/
 
-    // Let us iterate over queue families and check if it works for our needs
+static DeviceScore
+scoreDevice(const DeviceCapabilities &caps, double calibrationGBps) {
+    DeviceScore score;
+
+    // device type dominates, the rest orders devices of the same type
+    switch(caps.properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      score.type = 1000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    score.type = 500;  break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       score.type = 200;  break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:               score.type = 10;   break;
+        default:                                        score.type = 50;   break;
+    }
 
-    for(size_t i = 0; i < qFamilies.size(); ++i) {
-        if(qFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            indices.graphicsFamily = i;
+    // one point per 256 MiB. Integrated gpus report shared system memory
+    // here, the type score keeps them below discrete ones
+    VkDeviceSize largestHeap = 0;
+    for(uint32_t i = 0; i < caps.memoryProperties.memoryHeapCount; ++i) {
+        const VkMemoryHeap &heap = caps.memoryProperties.memoryHeaps[i];
+        if(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            largestHeap = std::max(largestHeap, heap.size);
         }
+    }
+    score.memory = static_cast<uint32_t>(std::min<VkDeviceSize>(largestHeap >> 28,
+                                                                200));
 
-        // find presentation family
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i , surface, &presentSupport);
+    score.imageSize = caps.properties.limits.maxImageDimension2D / 1024;
 
-        if(presentSupport) {
-            indices.presentFamily = i;
+    // async compute and copy engines show up as families without graphics
+    for(const auto &family : caps.queueFamilies) {
+        if(!(family.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+           (family.queueFlags & (VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT))) {
+            score.queues += 10;
         }
+    }
 
-        if(indices.isComplete()) {
-            #ifndef NDEBUG
-                std::cout << "graphics family: " << indices.graphicsFamily.value()
-                          << std::endl;
-
-                std::cout << "present family: " << indices.presentFamily.value()
-                          << std::endl;
-            #endif
-
-            break;
-        }
+    // no queue family ownership transfer between graphics and present
+    const QueueFamilyIndices &indices = caps.queueFamilyIndices;
+    if(indices.isComplete() &&
+       indices.graphicsFamily.value() == indices.presentFamily.value()) {
+        score.queues += 5;
     }
 
-    return indices;
+    score.calibration = static_cast<uint32_t>(calibrationGBps * 10.0);
+
+    return score;
 }
 
 /*------------------------------------------------------------------*/
 
-static
-SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice &device,
-                                              VkSurfaceKHR &surface) {
-    //most swapchain queries take device and surface as first two parameters
-    // let us query capabilities
+static double
+calibrateDevice(const DeviceCapabilities &caps,
+                const VkAllocationCallbacks *pAllocator) {
+    // short benchmark on a throwaway logical device: fill bandwidth of a
+    // device local buffer on the graphics queue in GB/s, 0 when it cannot
+    // be measured. Handles start out null so one cleanup path covers every
+    // failure
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    double gbps = 0.0;
+
+    uint32_t family = caps.queueFamilyIndices.graphicsFamily.value();
+    float queuePriority = 1.0f;
+
+    VkDeviceQueueCreateInfo qCreateInfo {};
+        qCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        qCreateInfo.queueFamilyIndex = family;
+        qCreateInfo.queueCount = 1;
+        qCreateInfo.pQueuePriorities = &queuePriority;
 
-    SwapchainSupportDetails details;
+    VkDeviceCreateInfo deviceInfo {};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &qCreateInfo;
 
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device,
-                                             surface,
-                                             &details.capabilities);
+    VkBufferCreateInfo bufferInfo {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = CALIBRATION_BUFFER_SIZE;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    #ifndef NDEBUG
-        std::cout << INTENT_STR << "surface capabilities" << std::endl;
+    VkCommandPoolCreateInfo poolInfo {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = family;
 
-        std::cout << INTENT_SPACE << INTENT_STR << "minImageCount: "
-                  << details.capabilities.minImageCount << std::endl;
+    VkFenceCreateInfo fenceInfo {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-        std::cout << INTENT_SPACE << INTENT_STR << "maxImageCount: "
-                  << details.capabilities.maxImageCount << std::endl;
-    #endif
+    VkMemoryRequirements memRequirements {};
+    uint32_t typeIdx = 0;
 
-    // query for supported surface formats
-    uint32_t formatCnt;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCnt, nullptr);
+    bool ok = vkCreateDevice(caps.physicalDevice, &deviceInfo, pAllocator,
+                             &device) == VK_SUCCESS &&
+              vkCreateBuffer(device, &bufferInfo, pAllocator, &buffer) == VK_SUCCESS;
 
-    if(formatCnt != 0) {
-        details.formats.resize(formatCnt);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCnt,
-                                            details.formats.data());
+    if(ok) {
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+        ok = tryFindMemoryType(caps.memoryProperties,
+                               memRequirements.memoryTypeBits,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, typeIdx);
     }
 
-    // query for present mode
-    uint32_t presentModeCnt;
+    VkMemoryAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = typeIdx;
+
+    ok = ok &&
+         vkAllocateMemory(device, &allocInfo, pAllocator, &memory) == VK_SUCCESS &&
+         vkBindBufferMemory(device, buffer, memory, 0) == VK_SUCCESS &&
+         vkCreateCommandPool(device, &poolInfo, pAllocator, &pool) == VK_SUCCESS &&
+         vkCreateFence(device, &fenceInfo, pAllocator, &fence) == VK_SUCCESS;
+
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+    VkCommandBufferAllocateInfo cmdInfo {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.commandPool = pool;
+        cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdInfo.commandBufferCount = 1;
 
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCnt,
-                                              nullptr);
+    VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    if(presentModeCnt != 0) {
-        details.presentModes.resize(presentModeCnt);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface,
-                 &presentModeCnt, details.presentModes.data());
+    ok = ok &&
+         vkAllocateCommandBuffers(device, &cmdInfo, &cmd) == VK_SUCCESS &&
+         vkBeginCommandBuffer(cmd, &beginInfo) == VK_SUCCESS;
+
+    if(ok) {
+        for(uint32_t i = 0; i < CALIBRATION_FILLS; ++i) {
+            vkCmdFillBuffer(cmd, buffer, 0, VK_WHOLE_SIZE, i);
+        }
+        ok = vkEndCommandBuffer(cmd) == VK_SUCCESS;
     }
 
-    return details;
-}
+    if(ok) {
+        VkQueue queue;
+        vkGetDeviceQueue(device, family, 0, &queue);
 
-/*------------------------------------------------------------------*/
+        VkSubmitInfo submitInfo {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cmd;
 
-static bool
-isDeviceSuitable(VkPhysicalDevice & device, VkSurfaceKHR &surface) {
-    QueueFamilyIndices indices = findQueueFamilies(device, surface);
+        // first submission pages the buffer in and warms up clocks
+        for(int round = 0; ok && round < 2; ++round) {
+            auto start = std::chrono::steady_clock::now();
+
+            ok = vkQueueSubmit(queue, 1, &submitInfo, fence) == VK_SUCCESS &&
+                 vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS &&
+                 vkResetFences(device, 1, &fence) == VK_SUCCESS;
 
-    bool extsSupported = checkDeviceExtSupported(device);
+            std::chrono::duration<double> elapsed =
+                                std::chrono::steady_clock::now() - start;
 
-    bool swapchainAdequate = false;
-    if(extsSupported) {
-        SwapchainSupportDetails swapchainSupport = querySwapchainSupport(device,
-                                                                         surface);
-        swapchainAdequate = !swapchainSupport.formats.empty() &&
-                            !swapchainSupport.presentModes.empty();
+            if(ok && round == 1 && elapsed.count() > 0.0) {
+                gbps = static_cast<double>(CALIBRATION_BUFFER_SIZE) *
+                       CALIBRATION_FILLS / elapsed.count() / 1e9;
+            }
+        }
+    }
+
+    if(device != VK_NULL_HANDLE) {
+        vkDestroyFence(device, fence, pAllocator);
+        vkDestroyCommandPool(device, pool, pAllocator);
+        vkDestroyBuffer(device, buffer, pAllocator);
+        vkFreeMemory(device, memory, pAllocator);
+        vkDestroyDevice(device, pAllocator);
     }
 
-    return indices.isComplete() && extsSupported && swapchainAdequate;
+    return gbps;
 }
 
 /*------------------------------------------------------------------*/
 
-static void printDeviceSpecification(VkPhysicalDevice &device) {
-    VkPhysicalDeviceProperties deviceProperties;
+static const char *
+deviceTypeName(VkPhysicalDeviceType type) {
+    switch(type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:      return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:    return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:       return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:               return "cpu";
+        default:                                        return "other";
+    }
+}
 
-    //get all device properties
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+/*------------------------------------------------------------------*/
 
-    VkPhysicalDeviceFeatures deviceFeatures;
+// index of the device DEVICE_OVERRIDE_ENV names, -1 when it is not set.
+// Throws when it is set but matches nothing
+static int
+findDeviceOverride(const std::vector<DeviceCapabilities> &candidates) {
+    const char *value = std::getenv(DEVICE_OVERRIDE_ENV);
 
-    // print them
-    std::cout << INTENT_STR << "Current Device Property: " << std::endl;
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Device Name: " << deviceProperties.deviceName << std::endl;
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Device VendorID: " << deviceProperties.vendorID << std::endl;
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Device Type: " << deviceProperties.deviceType << std::endl;
+    if(value == nullptr || *value == '\0') {
+        return -1;
+    }
 
-    // get all device features
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    // a plain number is an index, anything else part of the name
+    char *end = nullptr;
+    unsigned long idx = std::strtoul(value, &end, 10);
 
-    // print them
-    std::cout << INTENT_STR << "Current Device Features: " << std::endl;
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Geometry Shader :" << deviceFeatures.geometryShader << std::endl;
+    if(*end == '\0') {
+        if(idx < candidates.size()) {
+            return static_cast<int>(idx);
+        }
+    }
+    else {
+        for(size_t i = 0; i < candidates.size(); ++i) {
+            if(std::strstr(candidates[i].properties.deviceName, value) != nullptr) {
+                return static_cast<int>(i);
+            }
+        }
+    }
 
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Shader Float64 :" << deviceFeatures.shaderFloat64 << std::endl;
+    throw std::runtime_error(std::string(DEVICE_OVERRIDE_ENV) + "=" + value +
+                             " matches no vulkan device");
+}
 
-    std::cout << INTENT_SPACE << INTENT_STR
-              << "Shader Int64 :" << deviceFeatures.shaderInt64 << std::endl;
+/*------------------------------------------------------------------*/
+
+static uint32_t
+captureBytesPerPixel(VkFormat format) {
+    // readback assumes the 32 bit formats swapchains use in practice
+    switch(format) {
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return 4;
+        default:
+            return 0;
+    }
 }
 
 /*------------------------------------------------------------------*/
 
-static VkSurfaceFormatKHR
-chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR> &availableFormats) {
-    for( const auto & curAvailableFormat : availableFormats) {
-        if(curAvailableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
-           curAvailableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-            return curAvailableFormat;
-        }
+static FileView
+mapSpirvFile(const std::string &filename) {
+    // mapped, not copied. The page aligned mapping can be passed to
+    // VkShaderModuleCreateInfo as is
+    FileView file(filename, FileView::Access::Sequential);
+
+    // spir-v is a stream of 32 bit words
+    if(file.empty() || file.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("invalid spir-v size in " + filename);
     }
 
-    return availableFormats[0];
+    return file;
 }
 
 /*------------------------------------------------------------------*/
 
-static VkPresentModeKHR
-chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
-    for(const auto & availablePresentMode : availablePresentModes) {
-        if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            return availablePresentMode;
+static bool
+checkPipelineCacheHeader(const char *data, size_t dataSize,
+                         const VkPhysicalDeviceProperties &properties,
+                         const char *&reason) {
+    // VkPipelineCacheHeaderVersionOne, read field by field since the data
+    // has no alignment guarantee
+    uint32_t headerSize = 0;
+    uint32_t headerVersion = 0;
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint8_t uuid[VK_UUID_SIZE];
+
+    if(dataSize < 16 + VK_UUID_SIZE) {
+        reason = "truncated header";
+        return false;
     }
 
-    return VK_PRESENT_MODE_FIFO_KHR;
+    std::memcpy(&headerSize, data, 4);
+    std::memcpy(&headerVersion, data + 4, 4);
+    std::memcpy(&vendorID, data + 8, 4);
+    std::memcpy(&deviceID, data + 12, 4);
+    std::memcpy(uuid, data + 16, VK_UUID_SIZE);
+
+    if(headerSize < 16 + VK_UUID_SIZE || headerSize > dataSize ||
+       headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        reason = "unknown header version";
+        return false;
+    }
+
+    if(vendorID != properties.vendorID || deviceID != properties.deviceID) {
+        reason = "different device";
+        return false;
+    }
+
+    // the uuid changes with the driver build
+    if(std::memcmp(uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        reason = "different driver";
+        return false;
+    }
+
+    return true;
 }
 
 /*------------------------------------------------------------------*/
 
-static VkExtent2D
-chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities, GLFWwindow* window) {
-    auto &curExtent = capabilities.currentExtent;
-    if(curExtent.width != std::numeric_limits<uint32_t>::max()) {
-        return curExtent;
+static bool
+loadPipelineCacheFile(const std::string &path,
+                      const VkPhysicalDeviceProperties &properties,
+                      FileView &file, const char *&data, size_t &dataSize,
+                      const char *&reason) {
+    // the cache data is handed to the driver straight from the mapping
+    if(!file.map(path, FileView::Access::Sequential)) {
+        reason = "no cache file";
+        return false;
     }
-    else {
-        int width = 0;
-        int height = 0;
 
-        glfwGetFramebufferSize(window, &width, &height);
+    PipelineCacheFileHeader header {};
 
-        VkExtent2D actualExtent = {
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height)
-        };
+    if(file.size() < sizeof(header)) {
+        reason = "unknown file format";
+        return false;
+    }
 
-        actualExtent.width = std::clamp(actualExtent.width,
-                                       capabilities.minImageExtent.width,
-                                       capabilities.maxImageExtent.width);
+    std::memcpy(&header, file.data(), sizeof(header));
 
-        actualExtent.height = std::clamp(actualExtent.height,
-                                       capabilities.minImageExtent.height,
-                                       capabilities.maxImageExtent.width);
+    if(header.magic != PIPELINE_CACHE_MAGIC ||
+       header.version != PIPELINE_CACHE_FILE_VERSION) {
+        reason = "unknown file format";
+        return false;
+    }
 
-        return actualExtent;
+    data = file.as<char>() + sizeof(header);
+    dataSize = file.size() - sizeof(header);
+
+    if(header.dataSize != dataSize || fnv1aHash(data, dataSize) != header.dataHash) {
+        reason = "corrupt data";
+        return false;
     }
+
+    return checkPipelineCacheHeader(data, dataSize, properties, reason);
 }
 
 /*------------------------------------------------------------------*/
 
-static std::vector<char>
-readFile(const std::string &filename) {
-    // std::ios::ate -> start reading at the end of the file
-    // std::ios::binary - read the file as binary file
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    // check if the file can be opened
-    if(!file.is_open()) {
-        throw std::runtime_error("failed to open shader file!!!");
+static void
+writePipelineCacheFile(const std::string &path, const std::vector<char> &data) {
+    PipelineCacheFileHeader header {};
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.version = PIPELINE_CACHE_FILE_VERSION;
+        header.dataSize = data.size();
+        header.dataHash = fnv1aHash(data.data(), data.size());
+
+    // write aside and rename over the old file, so concurrent readers and
+    // crashes never see a partial file
+    std::string tmpPath = path + ".tmp";
+
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+
+        if(!file) {
+            std::remove(tmpPath.c_str());
+            throw std::runtime_error("failed to write pipeline cache file!");
+        }
     }
 
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    // move to front and read entire content
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("failed to replace pipeline cache file!");
+    }
+}
 
-    //close the file
-    file.close();
+/*------------------------------------------------------------------*/
 
-    assert(fileSize == buffer.size());
+static std::vector<PipelineVariant>
+makePipelineVariants(uint32_t count) {
+    // stand-in for a material list: walk the combinations of shader set,
+    // cull mode, winding, blending and color write mask. 360 are distinct,
+    // more repeat
+    static const VkCullModeFlags cullModes[] = { VK_CULL_MODE_BACK_BIT,
+                                                 VK_CULL_MODE_NONE,
+                                                 VK_CULL_MODE_FRONT_BIT };
+    static const VkFrontFace frontFaces[] = { VK_FRONT_FACE_CLOCKWISE,
+                                              VK_FRONT_FACE_COUNTER_CLOCKWISE };
+
+    std::vector<PipelineVariant> variants(count);
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t idx = i;
+
+        variants[i].shaderSet = idx % SHADER_SET_COUNT;
+        idx /= SHADER_SET_COUNT;
+        variants[i].cullMode = cullModes[idx % 3];
+        idx /= 3;
+        variants[i].frontFace = frontFaces[idx % 2];
+        idx /= 2;
+        variants[i].blendEnable = (idx % 2) != 0;
+        idx /= 2;
+
+        // the 15 non empty masks, all channels first
+        variants[i].colorWriteMask = 15 - (idx % 15);
+    }
 
-    return buffer;
+    return variants;
 }
 
 /*------------------------------------------------------------------*/
 
 static VkShaderModule
-createShaderModule(VkDevice &device, const std::vector<char> &code) {
+createShaderModule(VkDevice &device, const uint32_t *code, size_t codeSize,
+                   const VkAllocationCallbacks *pAllocator) {
     // wrap the shader code in a VkShaderModule object
 
     // NOTE: the size of the bytecode is specified in bytes
-    // bytecode pointer is a uint32_t pointer rather than char.
-    // so use reinterpret_cast
 
     VkShaderModuleCreateInfo createInfo {};
 
@@ -588,13 +940,13 @@ createShaderModule(VkDevice &device, const std::vector<char> &code) {
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 
         // shader code size and buffer pointer
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        createInfo.codeSize = codeSize;
+        createInfo.pCode = code;
 
     // create shader module
     VkShaderModule shaderModule = VK_NULL_HANDLE;
 
-    VkResult result = vkCreateShaderModule(device, &createInfo, nullptr,
+    VkResult result = vkCreateShaderModule(device, &createInfo, pAllocator,
                                            &shaderModule);
 
     if(result != VK_SUCCESS) {
@@ -616,13 +968,13 @@ HelloTriangleApplication::initWindow() {
     // create glfw with no api
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-    // no resizable window
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    // resizable window, the swapchain is recreated on size change
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     // create window
     window = glfwCreateWindow(
-                    WIDTH,      // in screen coordinates, must be  > 0
-                    HEIGHT,     // in screen coordinates, must be  > 0
+                    config.width,   // in screen coordinates, must be  > 0
+                    config.height,  // in screen coordinates, must be  > 0
                     TITLE,      // nullptr/utf-8 null terminated string
                     nullptr,    // monitor to use full screen mode
                                 // nullptr for windowed mode
@@ -631,21 +983,232 @@ HelloTriangleApplication::initWindow() {
                                 // - nullptr -- not to share resource
                                 // - applicable only to opengl context
              );
+
+    // route resize notifications back to this object
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowIconifyCallback(window, windowIconifyCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    framebufferExtent = { static_cast<uint32_t>(width),
+                          static_cast<uint32_t>(height) };
 }
 
 /*------------------------------------------------------------------*/
 
 void
-HelloTriangleApplication::setupDebugMessenger() {
-    if(!enableValidationLayers)
-        return;
+HelloTriangleApplication::framebufferResizeCallback(GLFWwindow *window,
+                                                    int width, int height) {
+    auto app = reinterpret_cast<HelloTriangleApplication *>(
+                                glfwGetWindowUserPointer(window));
+
+    WindowEvent event;
+        event.type = WindowEvent::Type::FramebufferResize;
+        event.arg0 = width;
+        event.arg1 = height;
+
+    if(!app->windowEvents.push(event)) {
+        ++app->droppedWindowEvents;
+    }
+}
 
-    VkDebugUtilsMessengerCreateInfoEXT createInfo {};
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::keyCallback(GLFWwindow *window, int key,
+                                      int /*scancode*/, int action,
+                                      int /*mods*/) {
+    auto app = reinterpret_cast<HelloTriangleApplication *>(
+                                glfwGetWindowUserPointer(window));
+
+    WindowEvent event;
+        event.type = WindowEvent::Type::Key;
+        event.arg0 = key;
+        event.arg1 = action;
+
+    if(!app->windowEvents.push(event)) {
+        ++app->droppedWindowEvents;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::windowIconifyCallback(GLFWwindow *window, int iconified) {
+    auto app = reinterpret_cast<HelloTriangleApplication *>(
+                                glfwGetWindowUserPointer(window));
+
+    WindowEvent event;
+        event.type = WindowEvent::Type::Iconify;
+        event.arg0 = iconified;
+
+    if(!app->windowEvents.push(event)) {
+        ++app->droppedWindowEvents;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::windowRefreshCallback(GLFWwindow *window) {
+    auto app = reinterpret_cast<HelloTriangleApplication *>(
+                                glfwGetWindowUserPointer(window));
+
+    WindowEvent event;
+        event.type = WindowEvent::Type::Refresh;
+
+    if(!app->windowEvents.push(event)) {
+        ++app->droppedWindowEvents;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::processWindowEvents() {
+    WindowEvent event;
+
+    while(windowEvents.pop(event)) {
+        switch(event.type) {
+            case WindowEvent::Type::FramebufferResize:
+                framebufferExtent = { static_cast<uint32_t>(event.arg0),
+                                      static_cast<uint32_t>(event.arg1) };
+                framebufferResized = true;
+                break;
+
+            case WindowEvent::Type::Key:
+                // 'P' cycles through the present mode policies
+                if(event.arg0 == GLFW_KEY_P && event.arg1 == GLFW_PRESS) {
+                    int next = (static_cast<int>(config.presentPolicy) + 1) %
+                               (static_cast<int>(PresentPolicy::Immediate) + 1);
+                    setPresentPolicy(static_cast<PresentPolicy>(next));
+
+                    std::cout << INTENT_STR << "present policy: "
+                              << presentPolicyName(config.presentPolicy)
+                              << std::endl;
+                }
+
+                // 'V' cycles through the pipeline variants
+                if(event.arg0 == GLFW_KEY_V && event.arg1 == GLFW_PRESS) {
+                    activePipeline = (activePipeline + 1) %
+                                     static_cast<uint32_t>(graphicsPipelines.size());
+                    markCommandBuffersDirty();
+                    frameDirty = true;
+
+                    std::cout << INTENT_STR << "pipeline variant: "
+                              << activePipeline << std::endl;
+                }
+                break;
+
+            case WindowEvent::Type::Iconify:
+                // contents may be gone once the window is restored
+                windowIconified = (event.arg0 == GLFW_TRUE);
+                frameDirty = true;
+                break;
+
+            case WindowEvent::Type::Refresh:
+                frameDirty = true;
+                break;
+        }
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::waitForWindowEvents() {
+    // glfw event functions are main thread only, the render thread waits for
+    // the main thread to hand it events instead
+    std::unique_lock<std::mutex> lock(renderWakeMutex);
+    renderWakeCv.wait_for(lock,
+                          std::chrono::duration<double>(EVENT_WAIT_TIMEOUT_SEC),
+                          [this]() {
+                              return !windowEvents.empty() || stopRendering;
+                          });
+    ++idleWaits;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::wakeRenderThread() {
+    // take the lock so the wakeup cannot slip in between the render thread
+    // checking its wait condition and going to sleep
+    {
+        std::lock_guard<std::mutex> lock(renderWakeMutex);
+    }
+    renderWakeCv.notify_one();
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+HelloTriangleApplication::isMinimized() const {
+    // some window systems keep the framebuffer size of iconified windows
+    return windowIconified ||
+           framebufferExtent.width == 0 || framebufferExtent.height == 0;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+HelloTriangleApplication::needsRedraw() const {
+    // pending recreations are done at the end of a frame, so they need one
+    return !config.onDemand || frameDirty ||
+           framebufferResized || presentPolicyChanged || pipelineReloadReady ||
+           pendingGeometryTicket != 0;     // keep polling the upload
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::limitFrameRate() {
+    if(config.targetFps <= 0.0) {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    auto period = std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(1.0 / config.targetFps));
+    auto now = Clock::now();
+
+    // more than a frame behind (hitch, idle, minimized), restart the cadence
+    // instead of bursting frames to catch up
+    if(now - nextFrameTime > period) {
+        nextFrameTime = now;
+    }
+
+    if(nextFrameTime - now > FRAME_SPIN_MARGIN) {
+        std::this_thread::sleep_until(nextFrameTime - FRAME_SPIN_MARGIN);
+    }
+
+    while(Clock::now() < nextFrameTime) {
+        std::this_thread::yield();
+    }
+
+    // scheduled from the deadline, not from now, so the average rate holds
+    nextFrameTime += period;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::setupDebugMessenger() {
+    if(!enableValidationLayers)
+        return;
+
+    VkDebugUtilsMessengerCreateInfoEXT createInfo {};
 
     populateDebugMessengerCreateInfo(createInfo);
     VkResult result = createDebugUtilsMessengerEXT(instance,
                                                    &createInfo,
-                                                   nullptr,
+                                                   pAllocator,
                                                    &debugMessenger);
 
     if(result != VK_SUCCESS) {
@@ -684,27 +1247,50 @@ HelloTriangleApplication::createVulkanInstance() {
         // vulkan api version -- highest version of vulkan api that app is
         // designed to support.
         // version has Variant(3), major(7), minor(10), and patch(12) fields
-        // calls VK_MAKE_API_VERSION(0, 1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // calls VK_MAKE_API_VERSION(0, 1, 2, 0) when the loader supports
+        // 1.2 (timeline semaphores), VK_MAKE_API_VERSION(0, 1, 0, 0) otherwise
+        instanceApiVersion = VK_API_VERSION_1_0;
+        if(config.timelineSemaphores &&
+           getInstanceApiVersion() >= VK_API_VERSION_1_2) {
+            instanceApiVersion = VK_API_VERSION_1_2;
+        }
+        appInfo.apiVersion = instanceApiVersion;
 
     // get required glfw extensions
-    auto requiredExt = getRequiredExtensions();
+    auto requiredExt = getRequiredExtensions(config.headless);
 
     if(enableValidationLayers) {
-        auto supportedExt = getSupportedExtensions();
-        auto status = checkGLFWExtensionSupport(requiredExt, supportedExt);
-        if(!status) {
-            throw std::runtime_error("required extensions are not supported");
-        }
+        // sorted properties straight from the loader or the enumeration
+        // cache, looked up without copying names
+        InstanceEnumeration available =
+                            InstanceEnumeration::query(config.instanceCachePath);
 
-        auto availableLayerNames = getSupportedValidationLayerNames();
+        #ifndef NDEBUG
+            std::cout << INTENT_STR << "Supported Extension Names"
+                      << (available.fromCache ? " (cached)" : "") << std::endl;
+            for(const auto &e : available.extensions) {
+                std::cout << INTENT_SPACE << INTENT_STR << e.extensionName
+                          << std::endl;
+            }
 
-        status = checkValidationLayerSupport(validationLayer, availableLayerNames);
+            std::cout << INTENT_STR << "Available Layer Names"
+                      << (available.fromCache ? " (cached)" : "") << std::endl;
+            for(const auto &l : available.layers) {
+                std::cout << INTENT_SPACE << INTENT_STR << l.layerName << std::endl;
+            }
+        #endif
 
-        if(!status) {
-            throw std::runtime_error("Validation layers requested, but unavailable");
+        for(const char *ext : requiredExt) {
+            if(!available.hasExtension(ext)) {
+                throw std::runtime_error("required extensions are not supported");
+            }
         }
 
+        for(const char *layer : validationLayer) {
+            if(!available.hasLayer(layer)) {
+                throw std::runtime_error("Validation layers requested, but unavailable");
+            }
+        }
     }
 
     // create Instance Info structure
@@ -750,7 +1336,7 @@ HelloTriangleApplication::createVulkanInstance() {
     // invoke api to create vulkan instance
     VkResult result = vkCreateInstance(
                         &createInfo,
-                        nullptr,
+                        pAllocator,
                         &instance
                       );
 
@@ -764,7 +1350,7 @@ HelloTriangleApplication::createVulkanInstance() {
 
 void
 HelloTriangleApplication::createSurface() {
-    VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+    VkResult result = glfwCreateWindowSurface(instance, window, pAllocator, &surface);
     if(result != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface!");
     }
@@ -790,20 +1376,86 @@ HelloTriangleApplication::pickPhysicalDevice() {
     // get the device list
     vkEnumeratePhysicalDevices(instance, &deviceCnt, devices.data());
 
+    // one capability snapshot per device, the chosen one is kept for the
+    // later stages
+    std::vector<DeviceCapabilities> candidates;
+    std::vector<bool> suitable;
+    size_t suitableCount = 0;
+
     for(auto & device : devices) {
+        candidates.push_back(DeviceCapabilities::query(instance,
+                                                       instanceApiVersion,
+                                                       device, surface));
         #ifndef NDEBUG
-            printDeviceSpecification(device);
+            printDeviceSpecification(candidates.back());
         #endif
 
-        if(isDeviceSuitable(device, surface)) {
-            physicalDevice = device;
-            break;
+        suitable.push_back(isDeviceSuitable(candidates.back(), config.headless));
+        suitableCount += suitable.back() ? 1 : 0;
+    }
+
+    // score every suitable device, calibration only matters with a choice
+    std::vector<DeviceScore> scores(candidates.size());
+    int best = -1;
+
+    for(size_t i = 0; i < candidates.size(); ++i) {
+        if(!suitable[i]) {
+            continue;
+        }
+
+        double gbps = (config.calibrateDevices && suitableCount > 1) ?
+                      calibrateDevice(candidates[i], pAllocator) : 0.0;
+
+        scores[i] = scoreDevice(candidates[i], gbps);
+
+        if(best < 0 || scores[i].total() > scores[best].total()) {
+            best = static_cast<int>(i);
+        }
+    }
+
+    int chosen = findDeviceOverride(candidates);
+
+    if(chosen >= 0 && !suitable[chosen]) {
+        throw std::runtime_error(std::string(DEVICE_OVERRIDE_ENV) + " selects "
+                                 + candidates[chosen].properties.deviceName
+                                 + ", which is not suitable");
+    }
+    if(chosen < 0) {
+        chosen = best;
+    }
+
+    std::cout << INTENT_STR << "device candidates (score = type + memory +"
+              << " image size + queues + calibration):" << std::endl;
+
+    for(size_t i = 0; i < candidates.size(); ++i) {
+        const DeviceScore &score = scores[i];
+
+        std::cout << INTENT_SPACE << INTENT_STR << (static_cast<int>(i) == chosen ? "* " : "  ")
+                  << i << ": " << candidates[i].properties.deviceName << " ("
+                  << deviceTypeName(candidates[i].properties.deviceType) << ") ";
+
+        if(suitable[i]) {
+            std::cout << score.total() << " = " << score.type << " + "
+                      << score.memory << " + " << score.imageSize << " + "
+                      << score.queues << " + " << score.calibration;
         }
+        else {
+            std::cout << "not suitable";
+        }
+        std::cout << std::endl;
     }
 
-    if(physicalDevice == VK_NULL_HANDLE) {
+    if(chosen < 0) {
         throw std::runtime_error("no suitable GPU found");
     }
+
+    if(chosen != best) {
+        std::cout << INTENT_STR << "device " << chosen << " selected by "
+                  << DEVICE_OVERRIDE_ENV << std::endl;
+    }
+
+    physicalDevice = candidates[chosen].physicalDevice;
+    deviceCaps = std::move(candidates[chosen]);
 }
 
 /*------------------------------------------------------------------*/
@@ -812,7 +1464,7 @@ void
 HelloTriangleApplication::createLogicalDevice() {
 
     // find the queue family
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
+    const QueueFamilyIndices &indices = deviceCaps.queueFamilyIndices;
 
     // queue priority value
     float queuePriority = 1.0f;
@@ -823,6 +1475,13 @@ HelloTriangleApplication::createLogicalDevice() {
                                               indices.presentFamily.value()
                                              };
 
+    // copies off the graphics queue, see createBufferUploader()
+    bool useTransferQueue = config.transferQueue &&
+                            indices.transferFamily.has_value();
+    if(useTransferQueue) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+
     for(uint32_t queueFamily : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo qCreateInfo {};
             // structure type
@@ -850,6 +1509,15 @@ HelloTriangleApplication::createLogicalDevice() {
     // for now, just leave it at the default initialized state
     VkPhysicalDeviceFeatures deviceFeatures {};
 
+    // timeline semaphores need to be enabled explicitly, fall back to
+    // fences when the device does not support them
+    useTimeline = config.timelineSemaphores && deviceCaps.timelineSemaphores;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {};
+        timelineFeatures.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+
     // create logical device
     VkDeviceCreateInfo createInfo {};
 
@@ -857,7 +1525,7 @@ HelloTriangleApplication::createLogicalDevice() {
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
         // nullptr/pointer to structure that extends this structure
-        createInfo.pNext = nullptr;
+        createInfo.pNext = useTimeline ? &timelineFeatures : nullptr;
 
         // flags reserved for future use
         createInfo.flags = 0;
@@ -883,8 +1551,9 @@ HelloTriangleApplication::createLogicalDevice() {
         }
 
         // global extension count -- deprecated
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(
-                    deviceExtensions.size());
+        // headless mode does not present and enables no swapchain
+        createInfo.enabledExtensionCount = config.headless ? 0 :
+                    static_cast<uint32_t>(deviceExtensions.size());
 
         // global extension names -- deprecated
         createInfo.ppEnabledExtensionNames = deviceExtensions.data();
@@ -894,7 +1563,7 @@ HelloTriangleApplication::createLogicalDevice() {
         createInfo.pEnabledFeatures = &deviceFeatures;
 
         VkResult result = vkCreateDevice(physicalDevice, &createInfo,
-                                         nullptr, &device);
+                                         pAllocator, &device);
 
         if(result != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
@@ -906,17 +1575,56 @@ HelloTriangleApplication::createLogicalDevice() {
 
         vkGetDeviceQueue(device, indices.presentFamily.value(),
                          0, &presentQueue);
+
+        if(useTransferQueue) {
+            vkGetDeviceQueue(device, indices.transferFamily.value(),
+                             0, &transferQueue);
+        }
+
+        if(useTimeline) {
+            // core 1.2 entry points, resolved through the device
+            pfnWaitSemaphores = (PFN_vkWaitSemaphores) vkGetDeviceProcAddr(
+                                        device, "vkWaitSemaphores");
+            pfnGetSemaphoreCounterValue =
+                (PFN_vkGetSemaphoreCounterValue) vkGetDeviceProcAddr(
+                                        device, "vkGetSemaphoreCounterValue");
+
+            if(pfnWaitSemaphores == nullptr ||
+               pfnGetSemaphoreCounterValue == nullptr) {
+                useTimeline = false;
+            }
+        }
+
+        #ifndef NDEBUG
+            std::cout << INTENT_STR << "frame sync: "
+                      << (useTimeline ? "timeline semaphore" : "fences")
+                      << std::endl;
+        #endif
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createMemoryAllocator() {
+    // every buffer and image is sub-allocated from a few large blocks
+    VkDeviceSize blockSize = static_cast<VkDeviceSize>(config.memoryBlockMiB) *
+                             1024 * 1024;
+
+    memoryAllocator = std::make_unique<DeviceMemoryAllocator>(device, deviceCaps,
+                                                              pAllocator, blockSize);
 }
 
 /*------------------------------------------------------------------*/
 void
 HelloTriangleApplication::createSwapchain() {
-    //get swap chain support
-    auto swapchainSupport = querySwapchainSupport(physicalDevice, surface);
+    //get swap chain support, from the snapshot taken in pickPhysicalDevice
+    const SwapchainSupportDetails &swapchainSupport = deviceCaps.swapchainSupport;
 
     auto surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
-    auto presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
-    auto extent = chooseSwapExtent(swapchainSupport.capabilities, window);
+    auto presentMode = chooseSwapPresentMode(swapchainSupport.presentModes,
+                                             config.presentPolicy);
+    auto extent = chooseSwapExtent(swapchainSupport.capabilities,
+                                   framebufferExtent);
 
     uint32_t imageCnt = swapchainSupport.capabilities.minImageCount + 1;
 
@@ -926,7 +1634,7 @@ HelloTriangleApplication::createSwapchain() {
     }
 
     // get indices
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
+    const QueueFamilyIndices &indices = deviceCaps.queueFamilyIndices;
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(),
                                      indices.presentFamily.value()};
 
@@ -945,6 +1653,15 @@ HelloTriangleApplication::createSwapchain() {
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+        // capture copies out of the swapchain images
+        if(config.capture) {
+            if(!(swapchainSupport.capabilities.supportedUsageFlags &
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+                throw std::runtime_error("swapchain images cannot be captured!");
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+
         if(indices.graphicsFamily != indices.presentFamily) {
             createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
             createInfo.queueFamilyIndexCount = 2;
@@ -960,21 +1677,80 @@ HelloTriangleApplication::createSwapchain() {
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
 
+        // on recreation hand the current swapchain to the driver so it can
+        // reuse its resources; it is retired by this call
+        createInfo.oldSwapchain = swapchain;
+
+    VkSwapchainKHR newSwapchain = VK_NULL_HANDLE;
     VkResult result = vkCreateSwapchainKHR(device, &createInfo,
-                                           nullptr, &swapchain);
+                                           pAllocator, &newSwapchain);
     if( result != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
 
+    // retired swapchain has no acquired images left, release it
+    if(swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(device, swapchain, pAllocator);
+    }
+    swapchain = newSwapchain;
+
     vkGetSwapchainImagesKHR(device, swapchain, &imageCnt, nullptr);
     swapchainImages.resize(imageCnt);
 
     vkGetSwapchainImagesKHR(device, swapchain, &imageCnt, swapchainImages.data());
 
     swapchainImageFormat = surfaceFormat.format;
+    swapchainPresentMode = presentMode;
     swapchainExtent = extent;
+
+    #ifndef NDEBUG
+        std::cout << INTENT_STR << "present mode: "
+                  << presentModeName(presentMode) << " (policy "
+                  << presentPolicyName(config.presentPolicy) << ")" << std::endl;
+    #endif
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createOffscreenImages() {
+    // as many images as a typical swapchain would have, so the frame slots
+    // rarely wait on an image still being rendered
+    uint32_t imageCnt = config.framesInFlight + 1;
+
+    swapchainImageFormat = OFFSCREEN_FORMAT;
+    swapchainExtent = framebufferExtent;
+
+    swapchainImages.resize(imageCnt);
+    offscreenImageMemory.resize(imageCnt);
+
+    for(uint32_t i = 0; i < imageCnt; ++i) {
+        // transfer source so frames can be read back
+        VkImageCreateInfo imageInfo {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = swapchainImageFormat;
+            imageInfo.extent = { swapchainExtent.width, swapchainExtent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        offscreenImageMemory[i] = memoryAllocator->createImage(imageInfo,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                            swapchainImages[i]);
+    }
+
+    #ifndef NDEBUG
+        std::cout << INTENT_STR << "headless: " << imageCnt << " offscreen images "
+                  << swapchainExtent.width << "x" << swapchainExtent.height
+                  << std::endl;
+    #endif
 }
 
 /*------------------------------------------------------------------*/
@@ -1003,7 +1779,7 @@ HelloTriangleApplication::createImageViews() {
             createInfo.subresourceRange.baseArrayLayer = 0;
             createInfo.subresourceRange.layerCount = 1;
 
-        VkResult result = vkCreateImageView(device, &createInfo, nullptr,
+        VkResult result = vkCreateImageView(device, &createInfo, pAllocator,
                                             &swapchainImageViews[i]);
 
         if(result != VK_SUCCESS) {
@@ -1016,14 +1792,144 @@ HelloTriangleApplication::createImageViews() {
 
 void
 HelloTriangleApplication::createGraphicsPipeline() {
+        // pipeline layout setup, shared by all variants
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
 
-    // vertex and fragment shader code
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 0;
+            pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
-    // create shader module
-    VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(device, fragShaderCode);
+        VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo,
+                                                 pAllocator, &pipelineLayout);
+
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout!");
+        }
+
+    // shader modules for every shader set, created once and only read by
+    // the build threads
+    std::vector<VkShaderModule> vertShaderModules(SHADER_SET_COUNT, VK_NULL_HANDLE);
+    std::vector<VkShaderModule> fragShaderModules(SHADER_SET_COUNT, VK_NULL_HANDLE);
+
+    variantList = makePipelineVariants(std::max(config.pipelineVariants, 1u));
+    const std::vector<PipelineVariant> &variants = variantList;
+    graphicsPipelines.assign(variants.size(), VK_NULL_HANDLE);
+
+    // pipeline creation is free threaded, including against one shared
+    // cache, so variants compile in parallel
+    uint32_t threadCount = config.buildThreads != 0 ? config.buildThreads :
+                           std::max(std::thread::hardware_concurrency(), 1u);
+
+    if(!buildPool && threadCount > 1 && variants.size() > 1) {
+        buildPool = std::make_unique<WorkerPool>(threadCount);
+    }
+
+    std::chrono::steady_clock::time_point createStart;
+
+    auto destroyShaderModules = [&]() {
+        for(uint32_t i = 0; i < SHADER_SET_COUNT; ++i) {
+            vkDestroyShaderModule(device, fragShaderModules[i], pAllocator);
+            vkDestroyShaderModule(device, vertShaderModules[i], pAllocator);
+        }
+    };
+
+    // a failed module or variant leaves nothing behind, parallelFor only
+    // rethrows once every build has returned
+    try {
+        for(uint32_t i = 0; i < SHADER_SET_COUNT; ++i) {
+            // vertex and fragment shader code, linked into the binary.
+            // --shader-dir loads compileShaders.sh output instead, to try shader
+            // changes without rebuilding
+            const ShaderSet &shaderSet = SHADER_SETS[i];
+
+            // shaders compiled from --shader-source or recompiled by
+            // --hot-reload replace either
+            if(i < reloadedShaders.size() && !reloadedShaders[i].vert.empty()) {
+                const ShaderSetCode &code = reloadedShaders[i];
+
+                vertShaderModules[i] = createShaderModule(device, code.vert.data(),
+                                            code.vert.size() * sizeof(uint32_t),
+                                            pAllocator);
+                fragShaderModules[i] = createShaderModule(device, code.frag.data(),
+                                            code.frag.size() * sizeof(uint32_t),
+                                            pAllocator);
+            }
+            else if(config.shaderDir.empty()) {
+                vertShaderModules[i] = createShaderModule(device, shaderSet.vertCode,
+                                                          shaderSet.vertCodeSize,
+                                                          pAllocator);
+                fragShaderModules[i] = createShaderModule(device, shaderSet.fragCode,
+                                                          shaderSet.fragCodeSize,
+                                                          pAllocator);
+            }
+            else {
+                FileView vertFile = mapSpirvFile(config.shaderDir + "/" +
+                                                 shaderSet.vertFile);
+                FileView fragFile = mapSpirvFile(config.shaderDir + "/" +
+                                                 shaderSet.fragFile);
+
+                vertShaderModules[i] = createShaderModule(device,
+                                                vertFile.as<uint32_t>(), vertFile.size(),
+                                                pAllocator);
+                fragShaderModules[i] = createShaderModule(device,
+                                                fragFile.as<uint32_t>(), fragFile.size(),
+                                                pAllocator);
+            }
+        }
+
+        createStart = std::chrono::steady_clock::now();
+
+        auto buildVariant = [&](size_t idx, size_t) {
+            const PipelineVariant &variant = variants[idx];
+            graphicsPipelines[idx] = buildPipeline(variant,
+                                                   vertShaderModules[variant.shaderSet],
+                                                   fragShaderModules[variant.shaderSet]);
+        };
+
+        if(buildPool) {
+            buildPool->parallelFor(variants.size(), buildVariant);
+        }
+        else {
+            for(size_t i = 0; i < variants.size(); ++i) {
+                buildVariant(i, 0);
+            }
+        }
+    } catch(...) {
+        for(auto pipeline : graphicsPipelines) {
+            vkDestroyPipeline(device, pipeline, pAllocator);
+        }
+        graphicsPipelines.clear();
+        destroyShaderModules();
+        throw;
+    }
+
+    std::chrono::duration<double, std::milli> createTime =
+                        std::chrono::steady_clock::now() - createStart;
+
+    // cold vs warm comparison across launches
+    std::cout << INTENT_STR << variants.size() << " graphics pipelines created in "
+              << createTime.count() << " ms on "
+              << (buildPool ? buildPool->size() : 1) << " threads ("
+              << (pipelineCache == VK_NULL_HANDLE ? "no cache" :
+                  pipelineCacheWarm ? "warm cache" : "cold cache")
+              << ")" << std::endl;
+
+    // destroy shader module
+    destroyShaderModules();
+
+    activePipeline = std::min(activePipeline,
+                              static_cast<uint32_t>(graphicsPipelines.size() - 1));
+}
+
+/*------------------------------------------------------------------*/
+
+VkPipeline
+HelloTriangleApplication::buildPipeline(const PipelineVariant &variant,
+                                        VkShaderModule vertShaderModule,
+                                        VkShaderModule fragShaderModule) const {
+    // called concurrently from the build threads, only reads shared state
 
     //assign shaders to pipeline stages
     VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
@@ -1044,15 +1950,19 @@ HelloTriangleApplication::createGraphicsPipeline() {
 
     // Fixed pipeline stage setup
     // vertex input stage - describes the format of the vertex data
-    // specify Bindings and Attrinute Descriptions
+    // specify Bindings and Attrinute Descriptions, generated from Vertex
+    VkVertexInputBindingDescription bindingDescription =
+                                            Vertex::bindingDescription();
+    auto attributeDescriptions = Vertex::attributeDescriptions();
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.pVertexBindingDescriptions = nullptr;
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
 
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-        vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+        vertexInputInfo.vertexAttributeDescriptionCount =
+                            static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         // Input Assembly
         VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
@@ -1060,30 +1970,15 @@ HelloTriangleApplication::createGraphicsPipeline() {
             inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
             inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        // Viewport stage setting
-        VkViewport viewport {};
-
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = (float) swapchainExtent.width;
-            viewport.height = (float) swapchainExtent.height;
-
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-
-        // scissor setting
-        VkRect2D scissor {};
-            scissor.offset = {0, 0};
-            scissor.extent = swapchainExtent;
-
-
         // pipeline viewport state
+        // viewport and scissor are dynamic state and set at record time,
+        // so the pipeline survives a swapchain extent change
         VkPipelineViewportStateCreateInfo viewportState {};
             viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
             viewportState.viewportCount = 1;
-            viewportState.pViewports = &viewport;
+            viewportState.pViewports = nullptr;
             viewportState.scissorCount = 1;
-            viewportState.pScissors = &scissor;
+            viewportState.pScissors = nullptr;
 
         // Rasterizer
         VkPipelineRasterizationStateCreateInfo rasterizer {};
@@ -1094,8 +1989,8 @@ HelloTriangleApplication::createGraphicsPipeline() {
             rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
             rasterizer.lineWidth = 1.0f;
 
-            rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-            rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+            rasterizer.cullMode = variant.cullMode;
+            rasterizer.frontFace = variant.frontFace;
 
             rasterizer.depthBiasEnable = VK_FALSE;
             rasterizer.depthBiasConstantFactor = 0.0f;
@@ -1115,13 +2010,14 @@ HelloTriangleApplication::createGraphicsPipeline() {
 
         // Color blend per attachment
         VkPipelineColorBlendAttachmentState colorBlendAttachment {};
-            colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-                                                  VK_COLOR_COMPONENT_G_BIT |
-                                                  VK_COLOR_COMPONENT_B_BIT |
-                                                  VK_COLOR_COMPONENT_A_BIT;
-            colorBlendAttachment.blendEnable = VK_FALSE;
-            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+            colorBlendAttachment.colorWriteMask = variant.colorWriteMask;
+            colorBlendAttachment.blendEnable = variant.blendEnable ? VK_TRUE : VK_FALSE;
+            colorBlendAttachment.srcColorBlendFactor = variant.blendEnable ?
+                                            VK_BLEND_FACTOR_SRC_ALPHA :
+                                            VK_BLEND_FACTOR_ONE;
+            colorBlendAttachment.dstColorBlendFactor = variant.blendEnable ?
+                                            VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA :
+                                            VK_BLEND_FACTOR_ZERO;
             colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
             colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
             colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -1142,7 +2038,7 @@ HelloTriangleApplication::createGraphicsPipeline() {
         // Dynamcic state configuration
         std::vector<VkDynamicState> dynamicStates = {
             VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_LINE_WIDTH
+            VK_DYNAMIC_STATE_SCISSOR
         };
 
         VkPipelineDynamicStateCreateInfo dynamicState {};
@@ -1150,22 +2046,6 @@ HelloTriangleApplication::createGraphicsPipeline() {
             dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
             dynamicState.pDynamicStates = dynamicStates.data();
 
-        // pipeline layout setup
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
-
-            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            pipelineLayoutInfo.setLayoutCount = 0;
-            pipelineLayoutInfo.pSetLayouts = nullptr;
-            pipelineLayoutInfo.pushConstantRangeCount = 0;
-            pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-        VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo,
-                                                 nullptr, &pipelineLayout);
-
-        if(result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline layout!");
-        }
-
     VkGraphicsPipelineCreateInfo pipelineInfo {};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineInfo.stageCount = 2;
@@ -1178,7 +2058,7 @@ HelloTriangleApplication::createGraphicsPipeline() {
         pipelineInfo.pMultisampleState = &multisampling;
         pipelineInfo.pDepthStencilState = nullptr;
         pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = nullptr;
+        pipelineInfo.pDynamicState = &dynamicState;
 
         pipelineInfo.layout = pipelineLayout;
 
@@ -1188,96 +2068,548 @@ HelloTriangleApplication::createGraphicsPipeline() {
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.basePipelineIndex = -1;
 
-        result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
-                                           &pipelineInfo, nullptr,
-                                           &graphicsPipeline);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1,
+                                                &pipelineInfo, pAllocator,
+                                                &pipeline);
 
    if(result != VK_SUCCESS) {
       throw std::runtime_error("failed to create graphics pipeline!!!");
    }
 
-    // destroy shader module
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
-
+    return pipeline;
 }
 
 /*------------------------------------------------------------------*/
 
 void
-HelloTriangleApplication::createRenderPass() {
-    VkAttachmentDescription colorAttachment {};
+HelloTriangleApplication::destroyGraphicsPipelines() {
+    // callers wait for the device to idle, retired pipelines are unused too
+    for(auto pipeline : graphicsPipelines) {
+        vkDestroyPipeline(device, pipeline, pAllocator);
+    }
+    graphicsPipelines.clear();
 
-        colorAttachment.format = swapchainImageFormat;
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    for(const auto &retired : retiredPipelines) {
+        vkDestroyPipeline(device, retired.pipeline, pAllocator);
+    }
+    retiredPipelines.clear();
 
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    vkDestroyPipelineLayout(device, pipelineLayout, pAllocator);
+}
 
-        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+/*------------------------------------------------------------------*/
 
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+void
+HelloTriangleApplication::createShaderCompiler() {
+    shaderCompiler = std::make_unique<ShaderCompiler>(config.shaderCacheDir);
 
-    VkAttachmentReference colorAttachmentRef {};
-        colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if(config.shaderSourceDir.empty()) {
+        return;
+    }
 
-    VkSubpassDescription subpass {};
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
+    // unchanged sources come out of the cache, so this costs a hash and a
+    // file read per stage rather than a compile
+    auto startTime = std::chrono::steady_clock::now();
 
-    // dependencies
-    VkSubpassDependency dependency {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
+    reloadedShaders.resize(SHADER_SET_COUNT);
 
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
+    for(uint32_t i = 0; i < SHADER_SET_COUNT; ++i) {
+        const ShaderSet &sources = SHADER_SETS[i];
 
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        reloadedShaders[i].vert = shaderCompiler->compileFile(
+                            config.shaderSourceDir + "/" + sources.vertSource);
+        reloadedShaders[i].frag = shaderCompiler->compileFile(
+                            config.shaderSourceDir + "/" + sources.fragSource);
+    }
 
-    VkRenderPassCreateInfo renderPassInfo {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+    auto endTime = std::chrono::steady_clock::now();
 
+    std::cout << INTENT_STR << "shaders from " << config.shaderSourceDir << ": "
+              << shaderCompiler->cacheHits() << " cached, "
+              << shaderCompiler->compiled() << " compiled in "
+              << std::chrono::duration<double, std::milli>(endTime - startTime).count()
+              << " ms" << std::endl;
+}
 
-    VkResult result = vkCreateRenderPass(device, &renderPassInfo, nullptr,
-                                         &renderPass);
+/*------------------------------------------------------------------*/
 
-    if(result != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render pass!!!");
-    }
+void
+HelloTriangleApplication::createShaderWatcher() {
+    reloadedShaders.resize(SHADER_SET_COUNT);
+
+    // the callback runs on the watcher thread, compiling and pipeline
+    // building never touch the render loop
+    shaderWatcher = std::make_unique<ShaderWatcher>(config.hotReloadDir,
+                        [this](const std::vector<std::string> &files) {
+                            reloadShaders(files);
+                        });
+
+    std::cout << INTENT_STR << "watching " << config.hotReloadDir
+              << " for shader changes" << std::endl;
 }
 
 /*------------------------------------------------------------------*/
+
 void
-HelloTriangleApplication::createFramebuffers() {
-    swapchainFramebuffers.resize(swapchainImageViews.size());
+HelloTriangleApplication::reloadShaders(const std::vector<std::string> &files) {
+    // a set is rebuilt if either of its stages changed
+    for(uint32_t i = 0; i < SHADER_SET_COUNT; ++i) {
+        const ShaderSet &shaderSet = SHADER_SETS[i];
+
+        bool changed = std::any_of(files.begin(), files.end(),
+                                   [&shaderSet](const std::string &file) {
+                                       return file == shaderSet.vertSource ||
+                                              file == shaderSet.fragSource;
+                                   });
+        if(!changed) {
+            continue;
+        }
 
-    for(size_t i = 0; i < swapchainImageViews.size(); ++i) {
-        VkImageView attachments[] = {
-            swapchainImageViews[i]
-        };
+        // a typo in a shader must not end the run, keep what is on screen
+        try {
+            reloadShaderSet(i);
+        } catch(const std::exception &e) {
+            std::cout << INTENT_STR << "shader reload failed, keeping the"
+                      << " current pipelines: " << e.what() << std::endl;
+        }
+    }
+}
 
-        VkFramebufferCreateInfo framebufferInfo {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::reloadShaderSet(uint32_t shaderSet) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    const ShaderSet &sources = SHADER_SETS[shaderSet];
+
+    ShaderSetCode code;
+    code.vert = shaderCompiler->compileFile(config.hotReloadDir + "/" +
+                                            sources.vertSource);
+    code.frag = shaderCompiler->compileFile(config.hotReloadDir + "/" +
+                                            sources.fragSource);
+
+    // render pass and layout stay valid while this lock is held
+    std::lock_guard<std::mutex> buildLock(pipelineBuildMutex);
+
+    VkShaderModule vertShaderModule = createShaderModule(device, code.vert.data(),
+                                        code.vert.size() * sizeof(uint32_t),
+                                        pAllocator);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    std::vector<PipelineReload> reloads;
+
+    try {
+        fragShaderModule = createShaderModule(device, code.frag.data(),
+                                        code.frag.size() * sizeof(uint32_t),
+                                        pAllocator);
+
+        for(size_t i = 0; i < variantList.size(); ++i) {
+            if(variantList[i].shaderSet == shaderSet) {
+                reloads.push_back({ i, buildPipeline(variantList[i],
+                                                     vertShaderModule,
+                                                     fragShaderModule) });
+            }
+        }
+    } catch(...) {
+        for(const auto &reload : reloads) {
+            vkDestroyPipeline(device, reload.pipeline, pAllocator);
+        }
+        vkDestroyShaderModule(device, fragShaderModule, pAllocator);
+        vkDestroyShaderModule(device, vertShaderModule, pAllocator);
+        throw;
+    }
+
+    vkDestroyShaderModule(device, fragShaderModule, pAllocator);
+    vkDestroyShaderModule(device, vertShaderModule, pAllocator);
+
+    // later pipeline rebuilds (format change) keep the new code
+    reloadedShaders[shaderSet] = std::move(code);
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineReloadMutex);
+
+        // a variant rebuilt twice before the render loop got to it
+        for(auto &reload : reloads) {
+            auto pending = std::find_if(pendingReloads.begin(), pendingReloads.end(),
+                                        [&reload](const PipelineReload &p) {
+                                            return p.variant == reload.variant;
+                                        });
+            if(pending != pendingReloads.end()) {
+                vkDestroyPipeline(device, pending->pipeline, pAllocator);
+                *pending = reload;
+            }
+            else {
+                pendingReloads.push_back(reload);
+            }
+        }
+        pipelineReloadReady = true;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed =
+                        std::chrono::steady_clock::now() - startTime;
+
+    std::cout << INTENT_STR << "reloaded " << sources.vertSource << "/"
+              << sources.fragSource << ": " << reloads.size()
+              << " pipelines in " << elapsed.count() << " ms" << std::endl;
+
+    // idle render loops only wake up for events
+    wakeRenderThread();
+    if(!config.headless) {
+        glfwPostEmptyEvent();
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::applyPipelineReloads() {
+    // replaced pipelines are destroyed once the last frame that may have
+    // bound them is done
+    retiredPipelines.erase(
+        std::remove_if(retiredPipelines.begin(), retiredPipelines.end(),
+                       [this](const RetiredPipeline &retired) {
+                           if(!isGpuFrameComplete(retired.frame)) {
+                               return false;
+                           }
+                           vkDestroyPipeline(device, retired.pipeline, pAllocator);
+                           return true;
+                       }),
+        retiredPipelines.end());
+
+    if(!pipelineReloadReady) {
+        return;
+    }
+
+    std::vector<PipelineReload> reloads;
+    {
+        std::lock_guard<std::mutex> lock(pipelineReloadMutex);
+        reloads.swap(pendingReloads);
+        pipelineReloadReady = false;
+    }
+
+    for(const auto &reload : reloads) {
+        retiredPipelines.push_back({ graphicsPipelines[reload.variant],
+                                     submittedFrameValue });
+        graphicsPipelines[reload.variant] = reload.pipeline;
+    }
+
+    // pre-recorded buffers still bind the old pipelines
+    markCommandBuffersDirty();
+    frameDirty = true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::discardPipelineReloads() {
+    std::lock_guard<std::mutex> lock(pipelineReloadMutex);
+
+    for(const auto &reload : pendingReloads) {
+        vkDestroyPipeline(device, reload.pipeline, pAllocator);
+    }
+    pendingReloads.clear();
+    pipelineReloadReady = false;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createPipelineCache() {
+    if(config.pipelineCachePath.empty()) {
+        return;
+    }
+
+    const VkPhysicalDeviceProperties &properties = deviceCaps.properties;
+
+    // stale or foreign data is dropped here rather than handed to the driver
+    FileView file;
+    const char *initialData = nullptr;
+    size_t initialDataSize = 0;
+    const char *reason = nullptr;
+
+    pipelineCacheWarm = loadPipelineCacheFile(config.pipelineCachePath,
+                                              properties, file, initialData,
+                                              initialDataSize, reason);
+    pipelineCacheHash = pipelineCacheWarm ?
+                        fnv1aHash(initialData, initialDataSize) : 0;
+
+    VkPipelineCacheCreateInfo cacheInfo {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = pipelineCacheWarm ? initialDataSize : 0;
+        cacheInfo.pInitialData = pipelineCacheWarm ? initialData : nullptr;
+
+    VkResult result = vkCreatePipelineCache(device, &cacheInfo, pAllocator,
+                                            &pipelineCache);
+
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    std::cout << INTENT_STR << "pipeline cache " << config.pipelineCachePath
+              << ": ";
+    if(pipelineCacheWarm) {
+        std::cout << "loaded " << initialDataSize << " bytes" << std::endl;
+    }
+    else {
+        std::cout << "cold (" << reason << ")" << std::endl;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::savePipelineCache() {
+    if(pipelineCache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t dataSize = 0;
+    vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr);
+
+    std::vector<char> data(dataSize);
+    VkResult result = vkGetPipelineCacheData(device, pipelineCache, &dataSize,
+                                             data.data());
+
+    if(result != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    data.resize(dataSize);
+
+    // nothing new was compiled, leave the file alone
+    if(pipelineCacheWarm &&
+       fnv1aHash(data.data(), data.size()) == pipelineCacheHash) {
+        return;
+    }
+
+    writePipelineCacheFile(config.pipelineCachePath, data);
+
+    #ifndef NDEBUG
+        std::cout << INTENT_STR << "pipeline cache saved, " << dataSize
+                  << " bytes" << std::endl;
+    #endif
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createRenderPass() {
+    bool readback = config.headless || config.capture;
+
+    VkAttachmentDescription colorAttachment {};
+
+        colorAttachment.format = swapchainImageFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        // offscreen images are never presented and captured images are
+        // copied first, leave them ready for readback
+        colorAttachment.finalLayout = readback ?
+                                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorAttachmentRef {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+
+    // dependencies
+    VkSubpassDependency dependencies[2] {};
+    VkSubpassDependency &dependency = dependencies[0];
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = 0;
+
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // readback: copies after the render pass wait for the color writes
+    VkSubpassDependency &readbackDependency = dependencies[1];
+        readbackDependency.srcSubpass = 0;
+        readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+        readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = readback ? 2 : 1;
+        renderPassInfo.pDependencies = dependencies;
+
+
+    VkResult result = vkCreateRenderPass(device, &renderPassInfo, pAllocator,
+                                         &renderPass);
+
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!!!");
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createDescriptorSetLayout() {
+    // one uniform block per draw, the offset is given at bind time
+    VkDescriptorSetLayoutBinding uniformBinding {};
+        uniformBinding.binding = 0;
+        uniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        uniformBinding.descriptorCount = 1;
+        uniformBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uniformBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &uniformBinding;
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, pAllocator,
+                                                  &descriptorSetLayout);
+
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createUniformRing() {
+    // pre-recorded buffers keep the offsets they were recorded with, so
+    // they rewrite their image's partition instead of the frame slot's
+    uint32_t partitionCount = config.prerecord ?
+                    static_cast<uint32_t>(swapchainImages.size()) :
+                    config.framesInFlight;
+
+    // swapchain recreation only grows it, the device is idle by then
+    if(uniformRing && uniformRing->partitionCount() >= partitionCount) {
+        return;
+    }
+
+    uniformRing.reset();
+    uniformRing = std::make_unique<UniformRing>(*memoryAllocator, deviceCaps,
+                                                partitionCount,
+                                                sizeof(DrawUniforms),
+                                                config.drawCount);
+
+    if(descriptorPool == VK_NULL_HANDLE) {
+        VkDescriptorPoolSize poolSize {};
+            poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            poolSize.descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo poolInfo {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.maxSets = 1;
+            poolInfo.poolSizeCount = 1;
+            poolInfo.pPoolSizes = &poolSize;
+
+        VkDescriptorSetAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &descriptorSetLayout;
+
+        VkResult result = vkCreateDescriptorPool(device, &poolInfo, pAllocator,
+                                                 &descriptorPool);
+
+        if(result == VK_SUCCESS) {
+            allocInfo.descriptorPool = descriptorPool;
+            result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+        }
+
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+
+        uniformStartTime = std::chrono::steady_clock::now();
+    }
+
+    // written once, every draw only moves the dynamic offset
+    VkDescriptorBufferInfo bufferInfo {};
+        bufferInfo.buffer = uniformRing->buffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(DrawUniforms);
+
+    VkWriteDescriptorSet descriptorWrite {};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::writeDrawUniforms(uint32_t partition) {
+    DrawUniforms uniforms {};
+
+    // identity camera for now, the scene is in clip space
+    for(int i = 0; i < 4; ++i) {
+        uniforms.transform[i * 4 + i] = 1.0f;
+    }
+    uniforms.time = std::chrono::duration<float>(
+                        std::chrono::steady_clock::now() - uniformStartTime).count();
+
+    // the partition rewinds every frame and the blocks are allocated in the
+    // same order, so pre-recorded offsets stay valid
+    uniformRing->begin(partition);
+    drawUniformOffsets.resize(config.drawCount);
+
+    for(uint32_t i = 0; i < config.drawCount; ++i) {
+        UniformRing::Block block = uniformRing->allocate(sizeof(DrawUniforms));
+
+        // one sequential write, the ring may be uncached write combined
+        std::memcpy(block.data, &uniforms, sizeof(DrawUniforms));
+        drawUniformOffsets[i] = block.offset;
+    }
+
+    uniformRing->end();
+}
+
+/*------------------------------------------------------------------*/
+void
+HelloTriangleApplication::createFramebuffers() {
+    swapchainFramebuffers.resize(swapchainImageViews.size());
+
+    for(size_t i = 0; i < swapchainImageViews.size(); ++i) {
+        VkImageView attachments[] = {
+            swapchainImageViews[i]
+        };
+
+        VkFramebufferCreateInfo framebufferInfo {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = attachments;
         framebufferInfo.width = swapchainExtent.width;
         framebufferInfo.height = swapchainExtent.height;
         framebufferInfo.layers = 1;
 
-        VkResult result = vkCreateFramebuffer(device, &framebufferInfo, nullptr,
+        VkResult result = vkCreateFramebuffer(device, &framebufferInfo, pAllocator,
                                               &swapchainFramebuffers[i]);
 
         if(result != VK_SUCCESS) {
@@ -1288,16 +2620,110 @@ HelloTriangleApplication::createFramebuffers() {
 
 /*------------------------------------------------------------------*/
 
+void
+HelloTriangleApplication::cleanupSwapchain() {
+    // destroy framebuffers
+    for(auto framebuffer : swapchainFramebuffers) {
+        vkDestroyFramebuffer(device, framebuffer, pAllocator);
+    }
+    swapchainFramebuffers.clear();
+
+    // destroy image view
+    for(auto imageView : swapchainImageViews) {
+       vkDestroyImageView(device, imageView, pAllocator);
+    }
+    swapchainImageViews.clear();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::recreateSwapchain() {
+    // a minimized window has a zero sized framebuffer, retry once it is
+    // visible again
+    if(isMinimized()) {
+        framebufferResized = true;
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // framebuffers and views may still be used by frames in flight
+    vkDeviceWaitIdle(device);
+
+    // pending readbacks are complete, deliver them before the ring is resized
+    flushCaptures();
+
+    cleanupSwapchain();
+
+    VkFormat oldFormat = swapchainImageFormat;
+
+    // the extent and transform follow the window, formats and present modes
+    // stay as snapshotted
+    deviceCaps.refreshSurfaceCapabilities(surface);
+
+    // retires and releases the old swapchain
+    createSwapchain();
+    createImageViews();
+
+    // render pass and pipeline only depend on the image format, the extent
+    // is dynamic state. A format change is rare but needs a full rebuild
+    if(swapchainImageFormat != oldFormat) {
+        // a shader reload may be building against the old render pass, and
+        // whatever it already built is for the old format
+        std::lock_guard<std::mutex> buildLock(pipelineBuildMutex);
+        discardPipelineReloads();
+
+        destroyGraphicsPipelines();
+        vkDestroyRenderPass(device, renderPass, pAllocator);
+
+        createRenderPass();
+        createGraphicsPipeline();
+    }
+
+    createFramebuffers();
+    createCaptureBuffers();
+    createUniformRing();
+
+    // image count may differ, no frame slot owns the new images yet
+    imagesInFlight.assign(swapchainImages.size(), 0);
+    createImageCommandBuffers();
+
+    std::chrono::duration<double, std::milli> elapsed =
+                        std::chrono::steady_clock::now() - startTime;
+
+    double stallMs = elapsed.count();
+    recreateMinMs = (recreateCount.load() == 0) ? stallMs
+                                         : std::min(recreateMinMs, stallMs);
+    recreateMaxMs = std::max(recreateMaxMs, stallMs);
+    recreateTotalMs += stallMs;
+    ++recreateCount;
+
+    #ifndef NDEBUG
+        std::cout << INTENT_STR << "swapchain recreated "
+                  << swapchainExtent.width << "x" << swapchainExtent.height
+                  << " in " << stallMs << " ms" << std::endl;
+    #endif
+
+    // recreation stall is not accounted to any present mode
+    lastPresentTime = std::chrono::steady_clock::now();
+
+    // new swapchain images have undefined contents
+    frameDirty = true;
+}
+
+/*------------------------------------------------------------------*/
+
 void
 HelloTriangleApplication::createCommandPool() {
-    QueueFamilyIndices qFamilyIndices = findQueueFamilies(physicalDevice, surface);
+    const QueueFamilyIndices &qFamilyIndices = deviceCaps.queueFamilyIndices;
 
     VkCommandPoolCreateInfo poolInfo {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         poolInfo.queueFamilyIndex = qFamilyIndices.graphicsFamily.value();
 
-        VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr,
+        VkResult result = vkCreateCommandPool(device, &poolInfo, pAllocator,
                                               &commandPool);
 
         if(result != VK_SUCCESS) {
@@ -1305,21 +2731,380 @@ HelloTriangleApplication::createCommandPool() {
         }
 }
 
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createBufferUploader() {
+    const QueueFamilyIndices &indices = deviceCaps.queueFamilyIndices;
+
+    // transferQueue stays null without a transfer family or with
+    // --no-transfer-queue, the uploader then copies on the graphics queue
+    uint32_t transferFamily = transferQueue != VK_NULL_HANDLE ?
+                                        indices.transferFamily.value() :
+                                        indices.graphicsFamily.value();
+
+    bufferUploader = std::make_unique<BufferUploader>(device, *memoryAllocator,
+                                        pAllocator,
+                                        indices.graphicsFamily.value(),
+                                        graphicsQueue, transferFamily,
+                                        transferQueue);
+
+    std::cout << INTENT_STR << "uploads on "
+              << (bufferUploader->dedicated() ? "transfer queue family " :
+                                                "graphics queue family ")
+              << transferFamily << std::endl;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createGeometryBuffers() {
+    // the triangle is drawn from the first frame on. A --mesh-cells grid
+    // uploads alongside rendering and replaces it once resident, see
+    // applyGeometryUpload()
+    uint64_t ticket = uploadMesh(makeTriangleMesh(), geometry);
+    printBufferUpload("triangle", bufferUploader->wait(ticket), 0);
+
+    if(config.meshCells != 0) {
+        Mesh mesh = makeGridMesh(config.meshCells);
+
+        std::cout << INTENT_STR << "mesh: " << mesh.vertices.size() << " vertices, "
+                  << mesh.indices.size() << " indices" << std::endl;
+
+        pendingGeometryTicket = uploadMesh(mesh, pendingGeometry);
+        pendingGeometryFrame = frameCount;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+uint64_t
+HelloTriangleApplication::uploadMesh(const Mesh &mesh, Geometry &target) {
+    // drawn with a single vkCmdDrawIndexed
+    if(mesh.indices.size() > UINT32_MAX) {
+        throw std::runtime_error("mesh has too many indices!");
+    }
+
+    VkBufferCreateInfo bufferInfo {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = mesh.vertexBytes();
+        bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    target.vertexMemory = memoryAllocator->createBuffer(bufferInfo,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                        target.vertexBuffer);
+
+        bufferInfo.size = mesh.indexBytes();
+        bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    target.indexMemory = memoryAllocator->createBuffer(bufferInfo,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                        target.indexBuffer);
+
+    target.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+    // the mesh is copied into staging here and may go right after
+    return bufferUploader->submit({
+                { target.vertexBuffer, mesh.vertices.data(), mesh.vertexBytes(),
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT },
+                { target.indexBuffer, mesh.indices.data(), mesh.indexBytes(),
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                  VK_ACCESS_INDEX_READ_BIT } });
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::applyGeometryUpload() {
+    // replaced geometry is destroyed once the last frame that may have
+    // drawn it is done
+    retiredGeometry.erase(
+        std::remove_if(retiredGeometry.begin(), retiredGeometry.end(),
+                       [this](RetiredGeometry &retired) {
+                           if(!isGpuFrameComplete(retired.frame)) {
+                               return false;
+                           }
+                           destroyGeometry(retired.geometry);
+                           return true;
+                       }),
+        retiredGeometry.end());
+
+    if(pendingGeometryTicket == 0) {
+        return;
+    }
+
+    // still copying, keep drawing what is resident
+    BufferUploader::Timing timing;
+    if(!bufferUploader->poll(pendingGeometryTicket, &timing)) {
+        return;
+    }
+
+    // the acquire was just submitted, every frame from here on is ordered
+    // after it
+    retiredGeometry.push_back({ geometry, submittedFrameValue });
+    geometry = pendingGeometry;
+    pendingGeometry = Geometry();
+    pendingGeometryTicket = 0;
+
+    printBufferUpload("mesh", timing, frameCount - pendingGeometryFrame);
+
+    // pre-recorded buffers still bind the old geometry
+    markCommandBuffersDirty();
+    frameDirty = true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::destroyGeometry(Geometry &target) {
+    if(target.vertexBuffer != VK_NULL_HANDLE) {
+        memoryAllocator->destroyBuffer(target.vertexBuffer, target.vertexMemory);
+    }
+    if(target.indexBuffer != VK_NULL_HANDLE) {
+        memoryAllocator->destroyBuffer(target.indexBuffer, target.indexMemory);
+    }
+    target.indexCount = 0;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::destroyGeometryBuffers() {
+    // waits for uploads still in flight
+    bufferUploader.reset();
+
+    for(auto &retired : retiredGeometry) {
+        destroyGeometry(retired.geometry);
+    }
+    retiredGeometry.clear();
+
+    destroyGeometry(pendingGeometry);
+    destroyGeometry(geometry);
+    pendingGeometryTicket = 0;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createWorkerCommandPools() {
+    // pre-recorded buffers are recorded inline, parallel recording only
+    // pays off for the per frame path
+    if(config.recordThreads == 0 || config.prerecord) {
+        return;
+    }
+
+    recordPool = std::make_unique<WorkerPool>(config.recordThreads);
+
+    const QueueFamilyIndices &qFamilyIndices = deviceCaps.queueFamilyIndices;
+
+    // command pools are externally synchronized, so every slice a worker
+    // records gets its own pool, per frame slot so a slice can be reset
+    // while older frames still execute
+    size_t poolCount = static_cast<size_t>(config.framesInFlight) *
+                       config.recordThreads;
+
+    workerCommandPools.resize(poolCount);
+    secondaryCommandBuffers.resize(poolCount);
+
+    for(size_t i = 0; i < poolCount; ++i) {
+        VkCommandPoolCreateInfo poolInfo {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = qFamilyIndices.graphicsFamily.value();
+
+        VkResult result = vkCreateCommandPool(device, &poolInfo, pAllocator,
+                                              &workerCommandPools[i]);
+
+        if(result != VK_SUCCESS) {
+            throw  std::runtime_error("failed to create worker command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = workerCommandPools[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+        result = vkAllocateCommandBuffers(device, &allocInfo,
+                                          &secondaryCommandBuffers[i]);
+
+        if(result != VK_SUCCESS) {
+           throw std::runtime_error("failed to allocate secondary command buffers!");
+        }
+    }
+}
+
 /*------------------------------------------------------------------*/
 void
 HelloTriangleApplication::createCommandBuffer() {
+    // one command buffer per frame in flight, so the cpu can record frame
+    // N+1 while the gpu is still executing frame N
+    commandBuffers.resize(config.framesInFlight);
+
     VkCommandBufferAllocateInfo allocInfo {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
         VkResult result = vkAllocateCommandBuffers(device, &allocInfo,
-                                                   &commandBuffer);
+                                                   commandBuffers.data());
 
     if(result != VK_SUCCESS) {
        throw std::runtime_error("failed to allocate command buffers!");
     }
+
+    if(!config.prerecord) {
+        return;
+    }
+
+    // pre-recorded mode: the render pass/bind/draw sequence only depends on
+    // the framebuffer, so record it once per swapchain image and replay it
+    createImageCommandBuffers();
+
+    for(size_t i = 0; i < imageCommandBuffers.size(); ++i) {
+        recordCommandBuffer(imageCommandBuffers[i], static_cast<uint32_t>(i));
+        imageCommandBufferDirty[i] = false;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createImageCommandBuffers() {
+    if(!config.prerecord) {
+        return;
+    }
+
+    // reallocate only if the swapchain image count changed
+    if(imageCommandBuffers.size() != swapchainFramebuffers.size()) {
+        if(!imageCommandBuffers.empty()) {
+            vkFreeCommandBuffers(device, commandPool,
+                        static_cast<uint32_t>(imageCommandBuffers.size()),
+                        imageCommandBuffers.data());
+        }
+
+        imageCommandBuffers.resize(swapchainFramebuffers.size());
+
+        VkCommandBufferAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = static_cast<uint32_t>(
+                                                imageCommandBuffers.size());
+
+        VkResult result = vkAllocateCommandBuffers(device, &allocInfo,
+                                                   imageCommandBuffers.data());
+
+        if(result != VK_SUCCESS) {
+           throw std::runtime_error("failed to allocate image command buffers!");
+        }
+    }
+
+    // contents refer to the old framebuffers until re-recorded
+    markCommandBuffersDirty();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::markCommandBuffersDirty() {
+    // buffers are re-recorded lazily in drawFrame, once the gpu is done
+    // with the image they render into
+    imageCommandBufferDirty.assign(imageCommandBuffers.size(), true);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::recordDraws(VkCommandBuffer commandBuffer,
+                                      uint32_t firstDraw, uint32_t drawCount) {
+    //Basic draw commands
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      graphicsPipelines[activePipeline]);
+
+    // dynamic viewport and scissor follow the current swapchain extent.
+    // dynamic state is not inherited, every secondary sets its own
+    VkViewport viewport {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) swapchainExtent.width;
+        viewport.height = (float) swapchainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+        scissor.offset = {0, 0};
+        scissor.extent = swapchainExtent;
+
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // bindings are not inherited either
+    VkDeviceSize vertexOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, Vertex::BINDING, 1,
+                           &geometry.vertexBuffer, &vertexOffset);
+    vkCmdBindIndexBuffer(commandBuffer, geometry.indexBuffer, 0,
+                         VK_INDEX_TYPE_UINT32);
+
+    // draws [firstDraw, firstDraw + drawCount) of the scene draw list,
+    // each with its own uniform block of the same set
+    for(uint32_t i = 0; i < drawCount; ++i) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipelineLayout, 0, 1, &descriptorSet,
+                                1, &drawUniformOffsets[firstDraw + i]);
+        vkCmdDrawIndexed(commandBuffer, geometry.indexCount, 1, 0, 0, 0);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::recordSecondaryCommandBuffer(size_t job, size_t jobCount,
+                                                       uint32_t imageIdx) {
+    size_t slot = currentFrame * jobCount + job;
+
+    // even slice of the draw list for this job
+    uint32_t firstDraw = static_cast<uint32_t>(config.drawCount * job / jobCount);
+    uint32_t lastDraw = static_cast<uint32_t>(config.drawCount * (job + 1) / jobCount);
+
+    // the frame slot wait in drawFrame guarantees the gpu is done with the
+    // pool, resetting the whole pool is cheaper than per buffer resets
+    vkResetCommandPool(device, workerCommandPools[slot], 0);
+
+    VkCommandBuffer commandBuffer = secondaryCommandBuffers[slot];
+
+    // secondary buffers continue the primary's render pass
+    VkCommandBufferInheritanceInfo inheritanceInfo {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = swapchainFramebuffers[imageIdx];
+
+    VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+    }
+
+    recordDraws(commandBuffer, firstDraw, lastDraw - firstDraw);
+
+    result = vkEndCommandBuffer(commandBuffer);
+
+    if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
 }
 
 /*------------------------------------------------------------------*/
@@ -1327,6 +3112,11 @@ HelloTriangleApplication::createCommandBuffer() {
 void
 HelloTriangleApplication::recordCommandBuffer(VkCommandBuffer commandBuffer,
                                               uint32_t imageIdx) {
+    // secondaries are per frame slot, pre-recorded buffers record inline
+    bool parallel = recordPool != nullptr && !config.prerecord;
+
+    auto recordStart = std::chrono::steady_clock::now();
+
     VkCommandBufferBeginInfo beginInfo {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = 0;
@@ -1351,20 +3141,218 @@ HelloTriangleApplication::recordCommandBuffer(VkCommandBuffer commandBuffer,
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if(parallel) {
+        // workers record slices of the draw list into secondary buffers
+        // concurrently, the primary only executes them
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                             VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    //Basic draw commands
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        size_t jobCount = recordPool->size();
+
+        recordPool->parallelFor(jobCount, [this, jobCount, imageIdx](size_t job,
+                                                                     size_t) {
+            recordSecondaryCommandBuffer(job, jobCount, imageIdx);
+        });
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(jobCount),
+                             &secondaryCommandBuffers[currentFrame * jobCount]);
+    }
+    else {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                             VK_SUBPASS_CONTENTS_INLINE);
+
+        recordDraws(commandBuffer, 0, config.drawCount);
+    }
 
     vkCmdEndRenderPass(commandBuffer);
 
+    if(config.capture) {
+        recordCapture(commandBuffer, imageIdx);
+    }
+
     result = vkEndCommandBuffer(commandBuffer);
 
     if(result != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
+
+    ++recordCount;
+
+    std::chrono::duration<double, std::milli> recordTime =
+                        std::chrono::steady_clock::now() - recordStart;
+    recordTimeTotalMs += recordTime.count();
+    ++recordedFrames;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::recordCapture(VkCommandBuffer commandBuffer,
+                                        uint32_t imageIdx) {
+    CaptureBuffer &capture = captureBuffers[currentFrame];
+
+    // whole image, tightly packed rows
+    VkBufferImageCopy region {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapchainExtent.width, swapchainExtent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, swapchainImages[imageIdx],
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           capture.buffer, 1, &region);
+
+    // make the copy visible to host reads once the frame completes
+    VkBufferMemoryBarrier bufferBarrier {};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = capture.buffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+    // swapchain images go back to the layout presentation expects
+    VkImageMemoryBarrier imageBarrier {};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = 0;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = swapchainImages[imageIdx];
+        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT |
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0, nullptr,
+                         1, &bufferBarrier,
+                         config.headless ? 0 : 1, &imageBarrier);
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::createCaptureBuffers() {
+    if(!config.capture) {
+        return;
+    }
+
+    uint32_t bytesPerPixel = captureBytesPerPixel(swapchainImageFormat);
+
+    if(bytesPerPixel == 0) {
+        throw std::runtime_error("capture does not support the image format!");
+    }
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(swapchainExtent.width) *
+                        swapchainExtent.height * bytesPerPixel;
+
+    captureBuffers.resize(config.framesInFlight);
+
+    for(auto &capture : captureBuffers) {
+        // keep buffers that are big enough, shrinking is not worth the
+        // stall on every resize
+        if(capture.capacity >= size) {
+            continue;
+        }
+
+        if(capture.buffer != VK_NULL_HANDLE) {
+            memoryAllocator->destroyBuffer(capture.buffer, capture.memory);
+        }
+
+        VkBufferCreateInfo bufferInfo {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        // cpu reads from uncached memory are an order of magnitude slower,
+        // prefer cached memory, invalidated before reading
+        capture.memory = memoryAllocator->createBuffer(bufferInfo,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                            capture.buffer);
+
+        capture.capacity = size;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::destroyCaptureBuffers() {
+    for(auto &capture : captureBuffers) {
+        if(capture.buffer == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        memoryAllocator->destroyBuffer(capture.buffer, capture.memory);
+    }
+    captureBuffers.clear();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::deliverCapture(uint32_t slot) {
+    CaptureBuffer &capture = captureBuffers[slot];
+
+    // caller made sure the frame is complete on the gpu
+    if(capture.frame == 0) {
+        return;
+    }
+
+    // no-op on coherent memory
+    memoryAllocator->invalidate(capture.memory);
+
+    uint32_t rowPitch = capture.extent.width *
+                        captureBytesPerPixel(swapchainImageFormat);
+
+    if(captureCallback) {
+        CapturedFrame frame;
+            frame.frame = capture.frame;
+            frame.extent = capture.extent;
+            frame.format = swapchainImageFormat;
+            frame.rowPitch = rowPitch;
+            frame.pixels = capture.memory.mapped;
+
+        auto callbackStart = std::chrono::steady_clock::now();
+
+        captureCallback(frame);
+
+        std::chrono::duration<double, std::milli> callbackTime =
+                            std::chrono::steady_clock::now() - callbackStart;
+        captureCallbackMs += callbackTime.count();
+    }
+
+    ++capturedFrames;
+    capturedBytes += static_cast<double>(rowPitch) * capture.extent.height;
+    capture.frame = 0;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::flushCaptures() {
+    // currentFrame is the next slot to be reused and holds the oldest
+    // frame, walking the ring from there delivers in submission order
+    for(uint32_t i = 0; i < captureBuffers.size(); ++i) {
+        deliverCapture((currentFrame + i) % config.framesInFlight);
+    }
 }
 
 /*------------------------------------------------------------------*/
@@ -1378,21 +3366,118 @@ HelloTriangleApplication::createSyncObjects() {
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    VkResult result = vkCreateSemaphore(device, &semaphoreInfo, nullptr,
-                                        &imageAvailableSemaphore);
-    if(result != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image available semaphore");
+    imageAvailableSemaphores.resize(config.framesInFlight);
+    renderFinishedSemaphores.resize(config.framesInFlight);
+    inFlightFences.assign(config.framesInFlight, VK_NULL_HANDLE);
+
+    // nothing submitted yet
+    slotFrameValues.assign(config.framesInFlight, 0);
+    imagesInFlight.assign(swapchainImages.size(), 0);
+
+    if(useTimeline) {
+        // one timeline for all frames, frame N signals value N
+        VkSemaphoreTypeCreateInfo typeInfo {};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo timelineInfo {};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            timelineInfo.pNext = &typeInfo;
+
+        VkResult result = vkCreateSemaphore(device, &timelineInfo, pAllocator,
+                                            &frameTimeline);
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame timeline semaphore");
+        }
     }
 
-    result = vkCreateSemaphore(device, &semaphoreInfo, nullptr,
-                                        &renderFinishedSemaphore);
-    if(result != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render finished semaphore");
+    for(uint32_t i = 0; i < config.framesInFlight; ++i) {
+        VkResult result = vkCreateSemaphore(device, &semaphoreInfo, pAllocator,
+                                            &imageAvailableSemaphores[i]);
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image available semaphore");
+        }
+
+        result = vkCreateSemaphore(device, &semaphoreInfo, pAllocator,
+                                   &renderFinishedSemaphores[i]);
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render finished semaphore");
+        }
+
+        // frame completion is tracked by the timeline instead
+        if(useTimeline) {
+            continue;
+        }
+
+        result = vkCreateFence(device, &fenceInfo, pAllocator, &inFlightFences[i]);
+        if(result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create in flight fence");
+        }
     }
+}
 
-    result = vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence);
-    if(result != VK_SUCCESS) {
-        throw std::runtime_error("failed to create in flight fence");
+/*------------------------------------------------------------------*/
+
+uint64_t
+HelloTriangleApplication::completedGpuFrame() {
+    if(useTimeline) {
+        uint64_t value = 0;
+        pfnGetSemaphoreCounterValue(device, frameTimeline, &value);
+        return value;
+    }
+
+    // frames execute in submission order on the graphics queue, so the
+    // oldest slot that is still busy bounds the completed frame
+    uint64_t completed = submittedFrameValue;
+
+    for(uint32_t i = 0; i < config.framesInFlight; ++i) {
+        if(slotFrameValues[i] != 0 && slotFrameValues[i] <= completed &&
+           vkGetFenceStatus(device, inFlightFences[i]) == VK_NOT_READY) {
+            completed = slotFrameValues[i] - 1;
+        }
+    }
+
+    return completed;
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+HelloTriangleApplication::isGpuFrameComplete(uint64_t frame) {
+    return frame <= completedGpuFrame();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::waitForGpuFrame(uint64_t frame) {
+    if(frame == 0) {
+        return;
+    }
+
+    if(frame > submittedFrameValue) {
+        throw std::logic_error("waiting for a gpu frame that was not submitted");
+    }
+
+    if(useTimeline) {
+        VkSemaphoreWaitInfo waitInfo {};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &frameTimeline;
+            waitInfo.pValues = &frame;
+
+        pfnWaitSemaphores(device, &waitInfo, UINT64_MAX);
+        return;
+    }
+
+    // the fence of the slot that still holds the frame. If the slot was
+    // reused since, its fence was waited on before and the frame is done
+    for(uint32_t i = 0; i < config.framesInFlight; ++i) {
+        if(slotFrameValues[i] == frame) {
+            vkWaitForFences(device, 1, &inFlightFences[i], VK_TRUE, UINT64_MAX);
+            return;
+        }
     }
 }
 
@@ -1400,70 +3485,270 @@ HelloTriangleApplication::createSyncObjects() {
 
 void
 HelloTriangleApplication::initVulkan() {
-    initWindow();
-    createVulkanInstance();
-    setupDebugMessenger();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapchain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createCommandBuffer();
-    createSyncObjects();
+    // every step is timed, see reportStartup()
+    // headless: no glfw at all, surface stays VK_NULL_HANDLE
+    if(config.headless) {
+        framebufferExtent = { config.width, config.height };
+    }
+    else {
+        timeStartupStep("initWindow", &HelloTriangleApplication::initWindow);
+    }
+    timeStartupStep("createVulkanInstance",
+                    &HelloTriangleApplication::createVulkanInstance);
+    timeStartupStep("setupDebugMessenger",
+                    &HelloTriangleApplication::setupDebugMessenger);
+    if(!config.headless) {
+        timeStartupStep("createSurface", &HelloTriangleApplication::createSurface);
+    }
+    timeStartupStep("pickPhysicalDevice",
+                    &HelloTriangleApplication::pickPhysicalDevice);
+    timeStartupStep("createLogicalDevice",
+                    &HelloTriangleApplication::createLogicalDevice);
+    timeStartupStep("createMemoryAllocator",
+                    &HelloTriangleApplication::createMemoryAllocator);
+    timeStartupStep("createPipelineCache",
+                    &HelloTriangleApplication::createPipelineCache);
+    if(config.headless) {
+        timeStartupStep("createOffscreenImages",
+                        &HelloTriangleApplication::createOffscreenImages);
+    }
+    else {
+        timeStartupStep("createSwapchain",
+                        &HelloTriangleApplication::createSwapchain);
+    }
+    timeStartupStep("createImageViews",
+                    &HelloTriangleApplication::createImageViews);
+    timeStartupStep("createRenderPass",
+                    &HelloTriangleApplication::createRenderPass);
+    timeStartupStep("createDescriptorSetLayout",
+                    &HelloTriangleApplication::createDescriptorSetLayout);
+    if(!config.shaderSourceDir.empty() || !config.hotReloadDir.empty()) {
+        timeStartupStep("createShaderCompiler",
+                        &HelloTriangleApplication::createShaderCompiler);
+    }
+    timeStartupStep("createGraphicsPipeline",
+                    &HelloTriangleApplication::createGraphicsPipeline);
+    timeStartupStep("createFramebuffers",
+                    &HelloTriangleApplication::createFramebuffers);
+    timeStartupStep("createCommandPool",
+                    &HelloTriangleApplication::createCommandPool);
+    timeStartupStep("createBufferUploader",
+                    &HelloTriangleApplication::createBufferUploader);
+    timeStartupStep("createGeometryBuffers",
+                    &HelloTriangleApplication::createGeometryBuffers);
+    timeStartupStep("createUniformRing",
+                    &HelloTriangleApplication::createUniformRing);
+    timeStartupStep("createWorkerCommandPools",
+                    &HelloTriangleApplication::createWorkerCommandPools);
+    timeStartupStep("createCommandBuffer",
+                    &HelloTriangleApplication::createCommandBuffer);
+    timeStartupStep("createSyncObjects",
+                    &HelloTriangleApplication::createSyncObjects);
+    timeStartupStep("createCaptureBuffers",
+                    &HelloTriangleApplication::createCaptureBuffers);
+    if(!config.hotReloadDir.empty()) {
+        timeStartupStep("createShaderWatcher",
+                        &HelloTriangleApplication::createShaderWatcher);
+    }
+
+    reportStartup();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::timeStartupStep(const char *name,
+                                    void (HelloTriangleApplication::*step)()) {
+    StartupProfiler::Scope scope(startupProfiler, name);
+    (this->*step)();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::reportStartup() {
+    // what the numbers depend on, so reports from different setups can be
+    // told apart
+    startupProfiler.note("device", deviceCaps.properties.deviceName);
+    startupProfiler.note("mode", config.headless ? "headless" : "window");
+    startupProfiler.note("pipelineCache",
+                         pipelineCache == VK_NULL_HANDLE ? "none" :
+                         pipelineCacheWarm ? "warm" : "cold");
+    startupProfiler.note("pipelineVariants",
+                         std::to_string(graphicsPipelines.size()));
+
+    startupProfiler.print();
+
+    if(!config.startupReportPath.empty()) {
+        startupProfiler.writeReport(config.startupReportPath);
+    }
+    if(!config.startupHistoryPath.empty()) {
+        startupProfiler.appendHistory(config.startupHistoryPath);
+    }
 }
 
 /*------------------------------------------------------------------*/
 
 void
 HelloTriangleApplication::drawFrame() {
-    // wait for the previous frame to finish
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+    // wait for the gpu to finish the frame that last used this slot.
+    // with more than one slot, the frames in between keep the gpu busy
+    waitForGpuFrame(slotFrameValues[currentFrame]);
+
+    // frame boundary, swap in pipelines a shader reload finished
+    applyPipelineReloads();
+
+    // and geometry whose upload finished
+    applyGeometryUpload();
+
+    // the frame that last used the slot is done, hand its pixels over
+    if(config.capture) {
+        deliverCapture(currentFrame);
+    }
+
+    // acquire-to-present latency starts here
+    auto acquireTime = std::chrono::steady_clock::now();
 
-    // above is the blocking call.  Once done, we need manual reset
-        vkResetFences(device, 1, &inFlightFence);
+   // acquire image from swap chain, headless takes the next offscreen image
+    uint32_t imageIdx = 0;
+    VkResult result = VK_SUCCESS;
 
-   // acquire image from swap chain
-    uint32_t imageIdx;
-    vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphore,
-                          VK_NULL_HANDLE, &imageIdx);
+    if(config.headless) {
+        imageIdx = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) %
+                             static_cast<uint32_t>(swapchainImages.size());
+    }
+    else {
+        result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+                                       imageAvailableSemaphores[currentFrame],
+                                       VK_NULL_HANDLE, &imageIdx);
+    }
+
+    // surface changed and the swapchain can no longer be presented to.
+    // nothing was submitted for the slot, so the frame can simply be retried
+    if(result == VK_ERROR_OUT_OF_DATE_KHR) {
+        recreateSwapchain();
+        return;
+    }
+    else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swapchain image!");
+    }
+
+    // the swapchain may hand out images out of order, so an older frame slot
+    // can still be rendering into this image
+    waitForGpuFrame(imagesInFlight[imageIdx]);
 
-    // record the command buffer
-    vkResetCommandBuffer(commandBuffer, 0);
-    recordCommandBuffer(commandBuffer, imageIdx);
+    // this frame brings the image up to date, a recreation below marks the
+    // new swapchain dirty again
+    frameDirty = false;
+
+    uint64_t frameValue = submittedFrameValue + 1;
+    imagesInFlight[imageIdx] = frameValue;
+
+    // both waits above are done, the gpu no longer reads either partition
+    writeDrawUniforms(config.prerecord ? imageIdx : currentFrame);
+
+    // above are the blocking calls.  Once done, the fence needs a manual
+    // reset. The timeline only ever moves forward and needs none
+    if(!useTimeline) {
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    }
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+    if(config.prerecord) {
+        // the image frame wait above guarantees its buffer is not pending
+        commandBuffer = imageCommandBuffers[imageIdx];
+
+        if(imageCommandBufferDirty[imageIdx]) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            recordCommandBuffer(commandBuffer, imageIdx);
+            imageCommandBufferDirty[imageIdx] = false;
+        }
+    }
+    else {
+        // record the command buffer
+        commandBuffer = commandBuffers[currentFrame];
+        vkResetCommandBuffer(commandBuffer, 0);
+        recordCommandBuffer(commandBuffer, imageIdx);
+    }
 
     // Submitting the command buffer
     VkSubmitInfo submitInfo {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
+    // headless frames have no acquire to wait for and nobody to present,
+    // only the timeline (if any) is signaled
+    uint32_t waitCount = config.headless ? 0 : 1;
+
+    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
     VkPipelineStageFlags waitStages[] = {
                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
                                         };
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = waitCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-    submitInfo.signalSemaphoreCount = 1;
+    // timeline backend: additionally signal the frame value on the timeline.
+    // values for the binary semaphores are ignored
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2];
+    uint32_t signalCount = 0;
+
+    if(!config.headless) {
+        signalSemaphores[signalCount] = renderFinishedSemaphores[currentFrame];
+        signalValues[signalCount++] = 0;
+    }
+    if(useTimeline) {
+        signalSemaphores[signalCount] = frameTimeline;
+        signalValues[signalCount++] = frameValue;
+    }
+
+    submitInfo.signalSemaphoreCount = signalCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence);
+    uint64_t waitValues[] = {0};
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = signalCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    if(useTimeline) {
+        submitInfo.pNext = &timelineInfo;
+    }
+
+    result = vkQueueSubmit(graphicsQueue, 1, &submitInfo,
+                           inFlightFences[currentFrame]);
 
     if(result != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
+    submittedFrameValue = frameValue;
+    slotFrameValues[currentFrame] = frameValue;
+
+    if(config.capture) {
+        captureBuffers[currentFrame].frame = frameValue;
+        captureBuffers[currentFrame].extent = swapchainExtent;
+    }
+
+    if(config.headless) {
+        // nothing to present, the frame is done once submitted
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+        ++frameCount;
+        return;
+    }
+
     // presentation
     VkPresentInfoKHR presentInfo {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
         VkSwapchainKHR swapchains[] = {swapchain};
         presentInfo.swapchainCount = 1;
@@ -1472,19 +3757,316 @@ HelloTriangleApplication::drawFrame() {
 
         presentInfo.pResults = nullptr;
 
-    vkQueuePresentKHR(presentQueue, &presentInfo);
+    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+
+    // account the frame to the present mode it was shown with
+    auto presentTime = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> latency = presentTime - acquireTime;
+    std::chrono::duration<double> frameTime = presentTime - lastPresentTime;
+    lastPresentTime = presentTime;
+
+    PresentModeStats &modeStats = presentModeStats[swapchainPresentMode];
+    ++modeStats.frames;
+    modeStats.seconds += frameTime.count();
+    modeStats.latencyTotalMs += latency.count();
+    modeStats.latencyMaxMs = std::max(modeStats.latencyMaxMs, latency.count());
+
+    // advance to the next frame slot
+    currentFrame = (currentFrame + 1) % config.framesInFlight;
+    ++frameCount;
+
+    // suboptimal is recreated as well, the frame was presented anyway
+    if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+       framebufferResized || presentPolicyChanged) {
+        framebufferResized = false;
+        presentPolicyChanged = false;
+        recreateSwapchain();
+    }
+    else if(result != VK_SUCCESS) {
+        throw std::runtime_error("failed to present swapchain image!");
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::printFrameStats(double elapsedSec, double cpuSec) const {
+    double fps = (elapsedSec > 0.0) ? frameCount / elapsedSec : 0.0;
+    double frameMs = (frameCount > 0) ? 1000.0 * elapsedSec / frameCount : 0.0;
+    double cpuUsage = (elapsedSec > 0.0) ? 100.0 * cpuSec / elapsedSec : 0.0;
+
+    std::cout << INTENT_STR << "Frame statistics" << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "target: "
+              << (config.headless ? "offscreen images" : "swapchain") << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "frames in flight: "
+              << config.framesInFlight << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "frame sync: "
+              << (useTimeline ? "timeline semaphore" : "fences") << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "render thread: "
+              << (config.renderThread ? "yes" : "no") << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "draws per frame: "
+              << config.drawCount << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "recording threads: "
+              << (recordPool ? recordPool->size() : 0) << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "target fps: ";
+    if(config.targetFps > 0.0) {
+        std::cout << config.targetFps << std::endl;
+    }
+    else {
+        std::cout << "uncapped" << std::endl;
+    }
+    std::cout << INTENT_SPACE << INTENT_STR << "on-demand: "
+              << (config.onDemand ? "yes" : "no") << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "pre-recorded: "
+              << (config.prerecord ? "yes" : "no") << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "frames: "
+              << frameCount << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "command buffers recorded: "
+              << recordCount << std::endl;
+
+    if(recordedFrames > 0) {
+        std::cout << INTENT_SPACE << INTENT_STR << "avg record time (ms): "
+                  << recordTimeTotalMs / recordedFrames << std::endl;
+    }
+    std::cout << INTENT_SPACE << INTENT_STR << "elapsed (s): "
+              << elapsedSec << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "throughput (fps): "
+              << fps << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "avg frame time (ms): "
+              << frameMs << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "cpu time (s): " << cpuSec
+              << " (" << cpuUsage << "% of one core)" << std::endl;
+    std::cout << INTENT_SPACE << INTENT_STR << "idle waits: "
+              << idleWaits << std::endl;
+
+    std::cout << INTENT_SPACE << INTENT_STR << "uniform ring: "
+              << uniformRing->partitionCount() << " x "
+              << uniformRing->partitionSize() / 1024.0 << " KiB, peak "
+              << uniformRing->peakBytes() / 1024.0 << " KiB per frame, "
+              << (uniformRing->coherent() ? "coherent" : "flushed") << std::endl;
+
+    memoryAllocator->print();
+
+    if(hostAllocator && frameCount > 0) {
+        std::cout << INTENT_SPACE << INTENT_STR << "host allocations per frame: "
+                  << static_cast<double>(loopHostAllocations) / frameCount
+                  << std::endl;
+    }
+
+    if(config.capture) {
+        double captureMBps = (elapsedSec > 0.0) ?
+                                capturedBytes / elapsedSec / 1.0e6 : 0.0;
+
+        std::cout << INTENT_SPACE << INTENT_STR << "captured frames: "
+                  << capturedFrames << std::endl;
+        std::cout << INTENT_SPACE << INTENT_STR << "capture readback (MB/s): "
+                  << captureMBps << std::endl;
+
+        if(capturedFrames > 0) {
+            std::cout << INTENT_SPACE << INTENT_STR
+                      << "avg capture callback (ms): "
+                      << captureCallbackMs / capturedFrames << std::endl;
+        }
+    }
+
+    if(droppedWindowEvents > 0) {
+        std::cout << INTENT_SPACE << INTENT_STR << "dropped window events: "
+                  << droppedWindowEvents << std::endl;
+    }
+
+    if(recreateCount > 0) {
+        std::cout << INTENT_SPACE << INTENT_STR << "swapchain recreations: "
+                  << recreateCount << std::endl;
+        std::cout << INTENT_SPACE << INTENT_STR << "recreation stall (ms)"
+                  << " min: " << recreateMinMs
+                  << " avg: " << recreateTotalMs / recreateCount
+                  << " max: " << recreateMaxMs << std::endl;
+    }
+
+    // per present mode report
+    for(const auto & [presentMode, modeStats] : presentModeStats) {
+        if(modeStats.frames == 0) {
+            continue;
+        }
+
+        double modeFps = (modeStats.seconds > 0.0) ?
+                            modeStats.frames / modeStats.seconds : 0.0;
+
+        std::cout << INTENT_SPACE << INTENT_STR << presentModeName(presentMode)
+                  << " frames: " << modeStats.frames
+                  << " fps: " << modeFps
+                  << " acquire-to-present avg (ms): "
+                  << modeStats.latencyTotalMs / modeStats.frames
+                  << " max (ms): " << modeStats.latencyMaxMs << std::endl;
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+bool
+HelloTriangleApplication::resizeStressStep() {
+    // frames to wait for the window system to apply a resize request
+    static const uint64_t RESIZE_TIMEOUT_FRAMES = 120;
+
+    // done once every request has been answered by a recreation
+    if(recreateCount >= config.resizeStress) {
+        return false;
+    }
+
+    // issue the next request once the previous one was applied, or the
+    // window manager ignored it
+    bool applied = recreateCount >= resizeRequests;
+    bool timedOut = frameCount - resizeRequestFrame > RESIZE_TIMEOUT_FRAMES;
+
+    if(resizeRequests == 0 || applied || timedOut) {
+        if(resizeRequests >= 2 * config.resizeStress) {
+            // window system keeps ignoring requests, give up
+            return false;
+        }
+
+        // alternate between a grid of sizes around the default one
+        int step = static_cast<int>(resizeRequests % 16);
+        int width = static_cast<int>(config.width) - 200 + 25 * step;
+        int height = static_cast<int>(config.height) - 150 + 20 * ((step * 7) % 16);
+
+        glfwSetWindowSize(window, width, height);
+
+        ++resizeRequests;
+        resizeRequestFrame = frameCount;
+    }
+
+    return true;
+}
+
+/*------------------------------------------------------------------*/
+
+void
+HelloTriangleApplication::renderLoop() {
+    try {
+        while(!stopRendering) {
+            processWindowEvents();
+
+            // nothing to render into or nothing changed, sleep until the
+            // main thread hands over window events
+            if(isMinimized() || !needsRedraw()) {
+                waitForWindowEvents();
+                continue;
+            }
+
+            limitFrameRate();
+            drawFrame();
+
+            if(config.maxFrames != 0 && frameCount >= config.maxFrames) {
+                break;
+            }
+        }
+    } catch(...) {
+        // hand the error to the main thread, which owns cleanup
+        renderError = std::current_exception();
+    }
+
+    vkDeviceWaitIdle(device);
+
+    // wake the main thread in case it is blocked waiting for events
+    renderThreadRunning = false;
+    glfwPostEmptyEvent();
 }
 
 /*------------------------------------------------------------------*/
 
 void
 HelloTriangleApplication::mainLoop() {
-    while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        drawFrame();
-       }
+    uint64_t startHostAllocations = hostAllocator ?
+                                    hostAllocator->allocationCount() : 0;
+    auto startTime = std::chrono::steady_clock::now();
+    std::clock_t startCpu = std::clock();
+    lastPresentTime = startTime;
+    nextFrameTime = startTime;
+
+    if(config.headless) {
+        // no window system to poll, render the requested frame count
+        while(frameCount < config.maxFrames) {
+            limitFrameRate();
+            drawFrame();
+        }
 
         vkDeviceWaitIdle(device);
+    }
+    else if(config.renderThread) {
+        // rendering cadence is independent of event handling; this thread
+        // only pumps glfw events into the queue
+        renderThreadRunning = true;
+        std::thread renderThread(&HelloTriangleApplication::renderLoop, this);
+
+        while(!glfwWindowShouldClose(window) && renderThreadRunning) {
+            if(config.resizeStress != 0) {
+                // resize requests are issued from here, keep polling
+                glfwWaitEventsTimeout(0.001);
+                if(!resizeStressStep()) {
+                    break;
+                }
+            }
+            else {
+                glfwWaitEvents();
+            }
+
+            wakeRenderThread();
+        }
+
+        stopRendering = true;
+        wakeRenderThread();
+        renderThread.join();
+
+        if(renderError) {
+            std::rethrow_exception(renderError);
+        }
+    }
+    else {
+        while(!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            processWindowEvents();
+
+            // nothing to render into, block until the window is restored
+            if(isMinimized()) {
+                glfwWaitEvents();
+                ++idleWaits;
+                continue;
+            }
+
+            // image on screen is current, block until something changes
+            if(!needsRedraw()) {
+                glfwWaitEventsTimeout(EVENT_WAIT_TIMEOUT_SEC);
+                ++idleWaits;
+                continue;
+            }
+
+            limitFrameRate();
+            drawFrame();
+
+            if(config.maxFrames != 0 && frameCount >= config.maxFrames) {
+                break;
+            }
+
+            if(config.resizeStress != 0 && !resizeStressStep()) {
+                break;
+            }
+           }
+
+            vkDeviceWaitIdle(device);
+    }
+
+    std::chrono::duration<double> elapsed =
+                        std::chrono::steady_clock::now() - startTime;
+    double cpuSec = static_cast<double>(std::clock() - startCpu) / CLOCKS_PER_SEC;
+    // device is idle, the last frames' readbacks are complete
+    flushCaptures();
+
+    if(hostAllocator) {
+        loopHostAllocations = hostAllocator->allocationCount() -
+                              startHostAllocations;
+    }
+
+    printFrameStats(elapsed.count(), cpuSec);
 }
 
 /*------------------------------------------------------------------*/
@@ -1492,56 +4074,93 @@ HelloTriangleApplication::mainLoop() {
 void
 HelloTriangleApplication::cleanup() {
     // destroy semaphore and fences
-    vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-    vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-    vkDestroyFence(device, inFlightFence, nullptr);
+    for(uint32_t i = 0; i < config.framesInFlight; ++i) {
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], pAllocator);
+        vkDestroySemaphore(device, renderFinishedSemaphores[i], pAllocator);
+        vkDestroyFence(device, inFlightFences[i], pAllocator);
+    }
+    vkDestroySemaphore(device, frameTimeline, pAllocator);
+
+    destroyCaptureBuffers();
+    destroyGeometryBuffers();
+    uniformRing.reset();
+    vkDestroyDescriptorPool(device, descriptorPool, pAllocator);
+
+    // stop recording workers, then destroy their pools
+    recordPool.reset();
+    for(auto pool : workerCommandPools) {
+        vkDestroyCommandPool(device, pool, pAllocator);
+    }
 
     // destroy commandpool
-    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, commandPool, pAllocator);
 
-    // destroy framebuffers
-    for(auto framebuffer : swapchainFramebuffers) {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    // destroy framebuffers and image views
+    cleanupSwapchain();
+
+    // headless images are owned by the application
+    if(config.headless) {
+        for(size_t i = 0; i < swapchainImages.size(); ++i) {
+            memoryAllocator->destroyImage(swapchainImages[i],
+                                          offscreenImageMemory[i]);
+        }
     }
 
-    // destroy pipeline
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    // stop reloads first, the watcher thread builds pipelines
+    shaderWatcher.reset();
+    discardPipelineReloads();
 
-    // destroy pipeline layout
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    // destroy pipelines and their layout
+    destroyGraphicsPipelines();
+    buildPool.reset();
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, pAllocator);
 
     // destroy render pass
-    vkDestroyRenderPass(device, renderPass, nullptr);
+    vkDestroyRenderPass(device, renderPass, pAllocator);
 
-    // destroy image view
-    for(auto imageView : swapchainImageViews) {
-       vkDestroyImageView(device, imageView, nullptr);
+    // destroy swapchain, headless never enabled the extension
+    if(!config.headless) {
+        vkDestroySwapchainKHR(device, swapchain, pAllocator);
     }
+    // keep what was compiled this run for the next launch
+    try {
+        savePipelineCache();
+    } catch(const std::exception &e) {
+        // a stale cache only costs startup time, do not fail shutdown
+        std::cout << e.what() << std::endl;
+    }
+    vkDestroyPipelineCache(device, pipelineCache, pAllocator);
+
+    // every buffer and image is gone, release the memory blocks
+    memoryAllocator.reset();
 
-    // destroy swapchain
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
     // Destroy logical device
-    vkDestroyDevice(device, nullptr);
+    vkDestroyDevice(device, pAllocator);
 
     // destroy debug Messenger callback
     if(enableValidationLayers) {
-        destroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+        destroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if(!config.headless) {
+        vkDestroySurfaceKHR(instance, surface, pAllocator);
+    }
 
     // All other vulkan objects should be released before this!!!
     // destroy instance
     vkDestroyInstance(
         instance,       // handle to instance object
-        nullptr         // host memory allocator
+        pAllocator      // host memory allocator
     );
 
-    // destroy window
-    glfwDestroyWindow(window);
+    // headless never initialized glfw
+    if(!config.headless) {
+        // destroy window
+        glfwDestroyWindow(window);
 
-    // terminate glfw
-    glfwTerminate();
+        // terminate glfw
+        glfwTerminate();
+    }
 }
 
 /*------------------------------------------------------------------*/
@@ -3,7 +3,151 @@
 #define GLFW_INCLUDE_VULKAN     // enable glfw to include vulkan headers
 #include <GLFW/glfw3.h>
 
+#include "spscQueue.h"
+#include "workerPool.h"
+#include "startupProfiler.h"
+#include "deviceCapabilities.h"
+#include "shaderWatcher.h"
+#include "shaderCompiler.h"
+#include "hostAllocator.h"
+#include "deviceMemory.h"
+#include "geometry.h"
+#include "uniformRing.h"
+#include "bufferUploader.h"
+
 #include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+
+/*------------------------------------------------------------------*/
+// Present mode selection policy
+/*------------------------------------------------------------------*/
+
+enum class PresentPolicy {
+    LowLatency,     // mailbox, else immediate, else fifo relaxed, else fifo
+    LowPower,       // fifo, cpu and gpu idle until the next vertical blank
+    TearFree,       // mailbox, else fifo -- tear free throughput (default)
+    Immediate       // immediate, uncapped and tearing, for benchmarking
+};
+
+const char * presentPolicyName(PresentPolicy policy);
+
+/*------------------------------------------------------------------*/
+// Window events handed from the glfw thread to the render loop
+/*------------------------------------------------------------------*/
+
+struct WindowEvent {
+    enum class Type {
+        FramebufferResize,      // width, height in pixels
+        Key,                    // key, action
+        Iconify,                // iconified (GLFW_TRUE/GLFW_FALSE)
+        Refresh                 // window contents damaged
+    };
+
+    Type type = Type::FramebufferResize;
+    int arg0 = 0;
+    int arg1 = 0;
+};
+
+/*------------------------------------------------------------------*/
+// Graphics pipeline variants
+/*------------------------------------------------------------------*/
+
+// Description of one pipeline to build. All variants share the render
+// pass, pipeline layout and pipeline cache and are compiled concurrently
+struct PipelineVariant {
+    uint32_t shaderSet = 0;         // 0 = shader.*, 1 = shader_1.*
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool blendEnable = false;       // alpha blending
+    VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                                           VK_COLOR_COMPONENT_G_BIT |
+                                           VK_COLOR_COMPONENT_B_BIT |
+                                           VK_COLOR_COMPONENT_A_BIT;
+};
+
+/*------------------------------------------------------------------*/
+// Frame readback
+/*------------------------------------------------------------------*/
+
+// A frame read back by --capture. pixels points straight into the mapped
+// staging buffer and is only valid for the duration of the callback
+struct CapturedFrame {
+    uint64_t frame = 0;             // gpu frame value, see submittedGpuFrame()
+    VkExtent2D extent = {0, 0};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t rowPitch = 0;          // bytes per row, rows are tightly packed
+    const void *pixels = nullptr;
+};
+
+using CaptureCallback = std::function<void(const CapturedFrame &frame)>;
+
+/*------------------------------------------------------------------*/
+// Application configuration
+/*------------------------------------------------------------------*/
+
+struct AppConfig {
+    uint32_t width = 800;           // window or offscreen image size
+    uint32_t height = 600;
+    uint32_t framesInFlight = 2;    // frames the cpu may record ahead of gpu
+    uint64_t maxFrames = 0;         // stop after this many frames, 0 = no limit
+    bool prerecord = false;         // record one command buffer per swapchain
+                                    // image up front, re-record only when dirty
+    uint32_t resizeStress = 0;      // resize the window this many times, report
+                                    // the stall per swapchain recreation and exit
+    PresentPolicy presentPolicy = PresentPolicy::TearFree;
+    bool timelineSemaphores = true; // use vulkan 1.2 timeline semaphores for
+                                    // frame sync when the device supports it
+    bool renderThread = false;      // render on a dedicated thread, the main
+                                    // thread only handles glfw events
+    uint32_t recordThreads = 0;     // threads recording secondary command
+                                    // buffers, 0 = record inline
+    uint32_t drawCount = 1;         // draws in the scene draw list
+    double targetFps = 0.0;         // cap the frame rate, 0 = uncapped
+    bool onDemand = false;          // render only when the image is stale,
+                                    // otherwise sleep until a window event
+    bool headless = false;          // no window or surface, render into
+                                    // offscreen images until maxFrames
+    bool capture = false;           // read every frame back to the cpu
+    std::string pipelineCachePath = "pipeline_cache.bin";
+                                    // on-disk pipeline cache, empty = none
+    std::string shaderDir;          // load spir-v files from here instead of
+                                    // the embedded shaders (development)
+    uint32_t pipelineVariants = 2;  // pipeline variants built at startup, 'V'
+                                    // cycles the one drawn
+    uint32_t buildThreads = 0;      // pipeline build threads, 0 = one per core
+    std::string shaderSourceDir;    // compile the glsl sources here at
+                                    // startup instead of the embedded shaders
+    std::string shaderCacheDir = "shader_cache";
+                                    // compiled spir-v by source hash, empty =
+                                    // always compile
+    std::string hotReloadDir;       // recompile and swap in glsl sources
+                                    // changed here, empty = off
+    std::string instanceCachePath;  // cache instance extension and layer
+                                    // enumeration here, empty = none
+    bool calibrateDevices = false;  // time a short benchmark on every device
+                                    // and add it to the selection score
+    std::string startupReportPath;  // write the startup phase timings here
+                                    // as json, empty = print only
+    std::string startupHistoryPath; // append the timings to this json lines
+                                    // file and print the summary across runs
+    bool hostAllocator = false;     // route driver host allocations through
+                                    // HostAllocator and report them per scope
+    uint32_t memoryBlockMiB = 0;    // device memory block size, 0 = default
+    uint32_t meshCells = 0;         // draw a cells x cells grid instead of
+                                    // the triangle, 0 = triangle
+    bool transferQueue = true;      // upload on a queue family without
+                                    // graphics when the device has one
+};
+
 /*------------------------------------------------------------------*/
 // Hello Triangle Application Class
 /*------------------------------------------------------------------*/
@@ -11,61 +155,318 @@
 class HelloTriangleApplication {
 
     public:
+        explicit HelloTriangleApplication(const AppConfig &appConfig = AppConfig());
+
         // top level run function that
         //      -- initializes all glfw/vulkan objects
         //      -- run rendering of images onto the screen
         //      -- cleansup glfw/vulkan objects
         void run();
 
+        // switch the present mode policy, takes effect with the swapchain
+        // recreation at the end of the current frame. Call from the thread
+        // that renders
+        void setPresentPolicy(PresentPolicy policy);
+
+        // consumer of --capture frames. Each frame is delivered framesInFlight
+        // frames after it was submitted, once the gpu finished it, on the
+        // rendering thread (the main thread for frames flushed at exit)
+        void setCaptureCallback(CaptureCallback callback);
+
+        // gpu frame tracking. Every submitted frame gets a monotonically
+        // increasing value starting at 1, a value of 0 is always complete
+        uint64_t submittedGpuFrame() const { return submittedFrameValue; }
+        uint64_t completedGpuFrame();
+        bool isGpuFrameComplete(uint64_t frame);
+        void waitForGpuFrame(uint64_t frame);
+
     private:
         void initWindow();              // glfw window init code
         void setupDebugMessenger();     // debug messenger setup code
         void createVulkanInstance();    // vulkan instance creation code
         void pickPhysicalDevice();      // vulkan physical device code
         void createLogicalDevice();     // vulkan logical device code
+        void createMemoryAllocator();   // buffer and image memory
+        void createPipelineCache();     // load the on-disk pipeline cache
+        void savePipelineCache();       // write it back if it changed
         void createSurface();           // vulkan surface creation code
         void createSwapchain();         // vulkan swapchain code
+        void createOffscreenImages();   // headless stand-in for the swapchain
+        void recreateSwapchain();       // rebuild swapchain after surface change
+        void cleanupSwapchain();        // release swapchain dependent objects
         void createImageViews();
-        void createGraphicsPipeline();
+        void createGraphicsPipeline();  // builds all pipeline variants
+        VkPipeline buildPipeline(const PipelineVariant &variant,
+                                 VkShaderModule vertShaderModule,
+                                 VkShaderModule fragShaderModule) const;
+        void destroyGraphicsPipelines();
+        void createShaderCompiler();    // --shader-source, --hot-reload
+        void createShaderWatcher();     // --hot-reload
+        void reloadShaders(const std::vector<std::string> &files);
+        void reloadShaderSet(uint32_t shaderSet);   // watcher thread
+        void applyPipelineReloads();    // render thread, frame boundary
+        void discardPipelineReloads();
         void createRenderPass();
+        void createDescriptorSetLayout();   // DrawUniforms, dynamic offset
+        void createUniformRing();       // and the descriptor set pointing at it
+        void writeDrawUniforms(uint32_t partition);
         void createFramebuffers();
         void createCommandPool();
+        void createBufferUploader();    // transfer queue when there is one
+        void createGeometryBuffers();   // vertex and index buffers, staged
+        void destroyGeometryBuffers();
+        void applyGeometryUpload();     // render thread, frame boundary
+        void createWorkerCommandPools();
         void createCommandBuffer();
+        void createImageCommandBuffers();
         void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIdx);
+        void recordSecondaryCommandBuffer(size_t job, size_t jobCount,
+                                          uint32_t imageIdx);
+        void recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw,
+                         uint32_t drawCount);
+        void markCommandBuffersDirty(); // pipeline, extent or scene changed
         void createSyncObjects();
+        void createCaptureBuffers();    // size the readback ring to the extent
+        void destroyCaptureBuffers();
+        void recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIdx);
+        void deliverCapture(uint32_t slot);
+        void flushCaptures();           // deliver all pending, device idle
         void drawFrame();
+        void printFrameStats(double elapsedSec, double cpuSec) const;
+        bool resizeStressStep();        // drive --resize-stress, false when done
         void initVulkan();              // vulkan init code
+        void timeStartupStep(const char *name,
+                             void (HelloTriangleApplication::*step)());
+        void reportStartup();           // print and save the startup timings
         void mainLoop();                // main rendering loop
+        void renderLoop();              // render thread body
+        void processWindowEvents();     // apply queued glfw events
+        void waitForWindowEvents();     // render thread idle wait
+        void wakeRenderThread();        // events queued or stop requested
+        bool isMinimized() const;       // iconified or zero sized framebuffer
+        bool needsRedraw() const;       // on-demand: image on screen is stale
+        void limitFrameRate();          // --fps pacing, call before drawFrame
         void cleanup();                 // cleanup/release all glfw/vulkan objects
 
+        static void framebufferResizeCallback(GLFWwindow *window,
+                                              int width, int height);
+        static void keyCallback(GLFWwindow *window, int key, int scancode,
+                                int action, int mods);
+        static void windowIconifyCallback(GLFWwindow *window, int iconified);
+        static void windowRefreshCallback(GLFWwindow *window);
+
     private:
+        AppConfig config;                        // command line configuration
+        std::unique_ptr<HostAllocator> hostAllocator;
+        // every create and destroy call, nullptr = driver's own allocator
+        const VkAllocationCallbacks *pAllocator = nullptr;
+        uint64_t loopHostAllocations = 0;       // during the frame loop
         GLFWwindow *window = nullptr;            // screen to render images
         // debug callback handle
         VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
         VkInstance instance = VK_NULL_HANDLE;    // vulkan instance
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        DeviceCapabilities deviceCaps;  // snapshot of physicalDevice
         VkDevice device = VK_NULL_HANDLE;
+        std::unique_ptr<DeviceMemoryAllocator> memoryAllocator;
+        uint32_t instanceApiVersion = VK_API_VERSION_1_0;
         VkQueue graphicsQueue = VK_NULL_HANDLE;  //opaque handle to queue object
         VkQueue presentQueue = VK_NULL_HANDLE;  //opaque handle to queue object
+        VkQueue transferQueue = VK_NULL_HANDLE; // null = uploads on graphics
         VkSurfaceKHR surface = VK_NULL_HANDLE;
-        VkSwapchainKHR swapchain;
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE;
         std::vector<VkImage> swapchainImages;
         VkFormat swapchainImageFormat;
+        VkPresentModeKHR swapchainPresentMode;
         VkExtent2D swapchainExtent;
         std::vector<VkImageView> swapchainImageViews;
         VkRenderPass renderPass;
         VkPipelineLayout pipelineLayout;
-        VkPipeline graphicsPipeline;
+        std::vector<VkPipeline> graphicsPipelines;  // one per variant
+        uint32_t activePipeline = 0;            // variant bound for drawing
+        std::unique_ptr<WorkerPool> buildPool;  // pipeline build threads
+        std::vector<PipelineVariant> variantList;   // graphicsPipelines built
+                                                    // from these
+
+        // shader hot reload: the watcher thread compiles changed sources and
+        // builds replacement pipelines, the render loop swaps them in at the
+        // next frame and destroys the old ones once the gpu is done
+        struct ShaderSetCode {
+            std::vector<uint32_t> vert;         // empty = not reloaded
+            std::vector<uint32_t> frag;
+        };
+        struct PipelineReload {
+            size_t variant;
+            VkPipeline pipeline;
+        };
+        struct RetiredPipeline {
+            VkPipeline pipeline;
+            uint64_t frame;                     // last frame that may use it
+        };
+        std::unique_ptr<ShaderCompiler> shaderCompiler;
+        std::unique_ptr<ShaderWatcher> shaderWatcher;
+        std::vector<ShaderSetCode> reloadedShaders;     // per shader set, also
+                                                        // --shader-source
+        std::mutex pipelineBuildMutex;          // render pass and layout stable
+        std::mutex pipelineReloadMutex;         // guards pendingReloads
+        std::vector<PipelineReload> pendingReloads;
+        std::atomic<bool> pipelineReloadReady {false};
+        std::vector<RetiredPipeline> retiredPipelines;  // render thread only
+
+        StartupProfiler startupProfiler;        // initVulkan step timings
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        bool pipelineCacheWarm = false;         // loaded valid data from disk
+        uint64_t pipelineCacheHash = 0;         // of the data loaded from disk
         std::vector<VkFramebuffer> swapchainFramebuffers;
         VkCommandPool commandPool;
-        VkCommandBuffer commandBuffer;
-        VkSemaphore imageAvailableSemaphore;  // image acquired from swapchain
-                                              // and is ready for rendering
-        VkSemaphore renderFinishedSemaphore;  // rendering finished and ready for
-                                              // presentation
-
-        VkFence inFlightFence;                // only one frame is rendered at
-                                              // a time
+
+        // headless mode: swapchainImages are owned by the application and
+        // handed out round robin instead of acquired
+        std::vector<DeviceMemoryAllocator::Allocation> offscreenImageMemory;
+        uint32_t nextOffscreenImage = 0;
+
+        // per frame in flight objects, indexed by currentFrame
+        std::vector<VkCommandBuffer> commandBuffers;
+        std::vector<VkSemaphore> imageAvailableSemaphores;  // image acquired from
+                                                            // swapchain and is
+                                                            // ready for rendering
+        std::vector<VkSemaphore> renderFinishedSemaphores;  // rendering finished
+                                                            // and ready for
+                                                            // presentation
+        std::vector<VkFence> inFlightFences;    // signaled when the gpu is done
+                                                // with the frame slot, unused
+                                                // with timeline semaphores
+
+        // timeline semaphore backend, counter value is the last completed
+        // gpu frame
+        bool useTimeline = false;
+        VkSemaphore frameTimeline = VK_NULL_HANDLE;
+        PFN_vkWaitSemaphores pfnWaitSemaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValue pfnGetSemaphoreCounterValue = nullptr;
+
+        uint64_t submittedFrameValue = 0;       // value of the last submit
+        std::vector<uint64_t> slotFrameValues;  // per slot, last frame submitted
+
+        // pre-recorded mode: one command buffer per swapchain framebuffer and
+        // a flag telling whether it must be re-recorded before next submit
+        std::vector<VkCommandBuffer> imageCommandBuffers;
+        std::vector<bool> imageCommandBufferDirty;
+        uint64_t recordCount = 0;               // command buffers recorded
+
+        // parallel recording: secondary command buffers recorded by a worker
+        // pool, one command pool and buffer per frame slot and worker slice,
+        // indexed [currentFrame * workers + slice]
+        std::unique_ptr<WorkerPool> recordPool;
+        std::vector<VkCommandPool> workerCommandPools;
+        std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+        // readback ring, one persistently mapped host visible buffer per
+        // frame slot. A slot is read once the gpu is done with the frame that
+        // last used it, so capture never waits on the gpu itself
+        struct CaptureBuffer {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            DeviceMemoryAllocator::Allocation memory;   // mapped for life
+            VkDeviceSize capacity = 0;
+            uint64_t frame = 0;                 // pending readback, 0 = none
+            VkExtent2D extent = {0, 0};
+        };
+        std::vector<CaptureBuffer> captureBuffers;
+
+        // scene geometry, device local, filled through staging buffers. A
+        // --mesh-cells grid uploads while the triangle is drawn and replaces
+        // it once the copy is done
+        struct Geometry {
+            VkBuffer vertexBuffer = VK_NULL_HANDLE;
+            VkBuffer indexBuffer = VK_NULL_HANDLE;
+            DeviceMemoryAllocator::Allocation vertexMemory;
+            DeviceMemoryAllocator::Allocation indexMemory;
+            uint32_t indexCount = 0;
+        };
+        struct RetiredGeometry {
+            Geometry geometry;
+            uint64_t frame;                     // last frame that may use it
+        };
+        std::unique_ptr<BufferUploader> bufferUploader;
+        Geometry geometry;                      // drawn
+        Geometry pendingGeometry;               // uploading
+        uint64_t pendingGeometryTicket = 0;     // 0 = none
+        uint64_t pendingGeometryFrame = 0;      // frameCount at submit
+        std::vector<RetiredGeometry> retiredGeometry;   // render thread only
+
+        // declared after Geometry
+        uint64_t uploadMesh(const Mesh &mesh, Geometry &target);
+        void destroyGeometry(Geometry &target);
+
+        // per draw uniforms, rewritten every frame into the ring partition
+        // of the frame slot (or image, pre-recorded) and bound at their
+        // dynamic offsets through the one descriptor set
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        std::unique_ptr<UniformRing> uniformRing;
+        std::vector<uint32_t> drawUniformOffsets;   // current frame, per draw
+        std::chrono::steady_clock::time_point uniformStartTime;
+        CaptureCallback captureCallback;
+        uint64_t capturedFrames = 0;
+        double capturedBytes = 0.0;
+        double captureCallbackMs = 0.0;         // consumer time
+
+        // cpu time spent recording per-frame command buffers
+        uint64_t recordedFrames = 0;
+        double recordTimeTotalMs = 0.0;
+
+        // per swapchain image, frame value currently rendering into it
+        // (0 if none)
+        std::vector<uint64_t> imagesInFlight;
+
+        uint32_t currentFrame = 0;              // frame slot being recorded
+        std::atomic<uint64_t> frameCount {0};   // frames submitted so far
+
+        // glfw callbacks run on the main thread and only queue events, the
+        // render loop drains the queue before each frame
+        SpscQueue<WindowEvent, 256> windowEvents;
+        std::atomic<uint64_t> droppedWindowEvents {0};
+
+        std::atomic<bool> stopRendering {false};    // main -> render thread
+        std::atomic<bool> renderThreadRunning {false};
+        std::exception_ptr renderError;         // rethrown on the main thread
+
+        // render thread sleeps here while idle, woken by the main thread
+        // after it queued window events
+        std::mutex renderWakeMutex;
+        std::condition_variable renderWakeCv;
+
+        // framebuffer size as last reported by glfw, owned by the render loop
+        VkExtent2D framebufferExtent = {0, 0};
+
+        bool framebufferResized = false;        // set by glfw resize event
+        bool presentPolicyChanged = false;      // set by setPresentPolicy
+        bool windowIconified = false;           // set by glfw iconify event
+        bool frameDirty = true;                 // on-demand: redraw needed
+
+        // frame limiter deadline of the next frame
+        std::chrono::steady_clock::time_point nextFrameTime;
+        uint64_t idleWaits = 0;                 // on-demand/minimized waits
+
+        // achieved frame rate and acquire-to-present latency per present mode
+        struct PresentModeStats {
+            uint64_t frames = 0;
+            double seconds = 0.0;               // frame time spent in the mode
+            double latencyTotalMs = 0.0;
+            double latencyMaxMs = 0.0;
+        };
+        std::map<VkPresentModeKHR, PresentModeStats> presentModeStats;
+        std::chrono::steady_clock::time_point lastPresentTime;
+
+        // swapchain recreation statistics
+        std::atomic<uint32_t> recreateCount {0};
+        double recreateTotalMs = 0.0;
+        double recreateMinMs = 0.0;
+        double recreateMaxMs = 0.0;
+
+        // --resize-stress progress
+        uint32_t resizeRequests = 0;            // window resizes requested
+        uint64_t resizeRequestFrame = 0;        // frame of the last request
 };
 
 /*------------------------------------------------------------------*/
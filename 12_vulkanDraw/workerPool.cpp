@@ -0,0 +1,118 @@
+#include "workerPool.h"
+
+#include <exception>
+#include <stdexcept>
+
+/*------------------------------------------------------------------*/
+// Public inferface definitions
+/*------------------------------------------------------------------*/
+
+WorkerPool::WorkerPool(size_t threadCount) {
+    if(threadCount == 0) {
+        throw std::invalid_argument("worker pool needs at least one thread");
+    }
+
+    threads.reserve(threadCount);
+    for(size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkerPool::workerMain, this, i);
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskCv.notify_all();
+
+    // queued tasks are still run before the workers exit
+    for(auto &thread : threads) {
+        thread.join();
+    }
+}
+
+/*------------------------------------------------------------------*/
+
+void
+WorkerPool::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back(std::move(task));
+    }
+    taskCv.notify_one();
+}
+
+/*------------------------------------------------------------------*/
+
+void
+WorkerPool::parallelFor(size_t jobCount,
+                        const std::function<void(size_t, size_t)> &fn) {
+    if(jobCount == 0) {
+        return;
+    }
+
+    // state shared by the jobs of this call, lives on the caller stack
+    // until every job has finished. Guarded by mutex
+    size_t remaining = jobCount;
+    std::exception_ptr error;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t job = 0; job < jobCount; ++job) {
+            tasks.emplace_back([this, job, &fn, &remaining, &error](size_t workerIdx) {
+                std::exception_ptr jobError;
+                try {
+                    fn(job, workerIdx);
+                } catch(...) {
+                    jobError = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if(jobError && !error) {
+                    error = jobError;
+                }
+                if(--remaining == 0) {
+                    doneCv.notify_all();
+                }
+            });
+        }
+    }
+    taskCv.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [&remaining]() { return remaining == 0; });
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/*------------------------------------------------------------------*/
+// Private inferface definitions
+/*------------------------------------------------------------------*/
+
+void
+WorkerPool::workerMain(size_t workerIdx) {
+    for(;;) {
+        Task task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskCv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if(tasks.empty()) {
+                // stopping and drained
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task(workerIdx);
+    }
+}
+
+/*------------------------------------------------------------------*/
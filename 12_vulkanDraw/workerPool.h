@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+/*------------------------------------------------------------------*/
+// Worker Pool Class
+/*------------------------------------------------------------------*/
+
+// Fixed set of worker threads pulling tasks from a shared queue. Each task
+// receives the index of the worker running it, so callers can keep per
+// thread scratch resources without locking.
+
+class WorkerPool {
+
+    public:
+        using Task = std::function<void(size_t workerIdx)>;
+
+        explicit WorkerPool(size_t threadCount);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool & operator=(const WorkerPool &) = delete;
+
+        size_t size() const { return threads.size(); }
+
+        // queue a task, it runs on some worker at some later point. The
+        // task must not throw
+        void submit(Task task);
+
+        // run fn(jobIdx, workerIdx) for every job in [0, jobCount) on the
+        // workers and return once all of them are done. The first exception
+        // thrown by a job is rethrown here
+        void parallelFor(size_t jobCount,
+                         const std::function<void(size_t, size_t)> &fn);
+
+    private:
+        void workerMain(size_t workerIdx);
+
+    private:
+        std::vector<std::thread> threads;
+        std::deque<Task> tasks;                 // guarded by mutex
+        std::mutex mutex;
+        std::condition_variable taskCv;         // new task or stopping
+        std::condition_variable doneCv;         // a parallelFor batch finished
+        bool stopping = false;
+};
+
+/*------------------------------------------------------------------*/